@@ -0,0 +1,28 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+// shared by the benchmarks
+struct Position {
+  float x;
+  float y;
+  float z;
+};
+
+struct Velocity {
+  float x;
+  float y;
+  float z;
+};
+
+// run f repeat times and print the mean time
+template <typename F>
+auto measure(const char *name, uint64_t repeat, F &&f) -> void {
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < repeat; i++) {
+    f();
+  }
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << name << ": " << elapsed.count() / repeat << " ms\n";
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include <pico_libs/ecs/world.hpp>
+#include <random>
+#include <vector>
+
+#include "benchmark.hpp"
+using namespace xac;
+
+using Settings = ecs::Settings<mpl::type_list<Position, Velocity>>;
+using EntityId = ecs::Entity<Settings>::Id;
+
+// fork a world, mutate 1% of the positions and throw the fork away, compared with copying the whole storage
+auto main() -> int {
+  constexpr uint64_t kRepeat = 60;
+  std::mt19937 seed(42);
+  for (uint64_t entity_count : {100000, 1000000, 5000000}) {
+    ecs::World<Settings> world;
+    std::vector<EntityId> entities;
+    for (uint64_t i = 0; i < entity_count; i++) {
+      auto e = world.create();
+      auto _ = world.assign<Position>(e, 1.f, 2.f, 3.f);
+      auto __ = world.assign<Velocity>(e, 1.f, 0.f, 0.f);
+      entities.push_back(e);
+    }
+    auto mutate_count = entity_count / 100;
+    std::uniform_int_distribution<uint64_t> rand_index(0, entity_count - 1);
+    std::vector<EntityId> random_entities;
+    for (uint64_t i = 0; i < mutate_count; i++) {
+      random_entities.push_back(entities[rand_index(seed)]);
+    }
+
+    std::cout << "entities: " << entity_count << "\n";
+    // baseline, what a deep copy of the world storage costs
+    std::vector<Position> positions(entity_count);
+    std::vector<Velocity> velocities(entity_count);
+    std::vector<uint64_t> tables(entity_count * 4);  // masks, versions, sparse and dense arrays
+    measure("  copy all storage", kRepeat, [&] {
+      auto p = positions;
+      auto v = velocities;
+      auto t = tables;
+      p[0].x += v[0].x + t[0];
+    });
+    measure("  fork", kRepeat, [&] { auto fork = world.fork(); });
+    measure("  fork + mutate 1% clustered", kRepeat, [&] {
+      auto fork = world.fork();
+      for (uint64_t i = 0; i < mutate_count; i++) {
+        fork.get_ptr<Position>(entities[i])->x += 1;
+      }
+    });
+    measure("  fork + mutate 1% random", kRepeat, [&] {
+      auto fork = world.fork();
+      for (auto &&e : random_entities) {
+        fork.get_ptr<Position>(e)->x += 1;
+      }
+    });
+    auto snapshot = world.fork();
+    measure("  mutate 1% clustered + restore", kRepeat, [&] {
+      for (uint64_t i = 0; i < mutate_count; i++) {
+        world.get_ptr<Position>(entities[i])->x += 1;
+      }
+      world.restore(snapshot);
+    });
+  }
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include <cmath>
+#include <pico_libs/ecs/spatial_grid.hpp>
+#include <pico_libs/ecs/world.hpp>
+#include <random>
+#include <vector>
+
+#include "benchmark.hpp"
+using namespace xac;
+
+struct Settings : ecs::Settings<mpl::type_list<Position, Velocity>> {
+  using ObserverList =
+      mpl::type_list<ecs::on_add<Position>, ecs::on_update<Position>, ecs::on_remove<Position>, ecs::on_destroy>;
+};
+using EntityId = ecs::Entity<Settings>::Id;
+using Grid = ecs::SpatialGrid<Settings, Position>;
+
+// radius queries through a uniform grid compared with scanning a view per query
+// entities are spread at a density of one per 8 cubic units, a query of radius 5 finds about 65 of them
+auto main() -> int {
+  constexpr uint64_t kQueryCount = 1000;
+  constexpr uint64_t kBruteForceQueryCount = 10;
+  constexpr float kRadius = 5;
+  std::mt19937 seed(42);
+  for (uint64_t entity_count : {100000, 1000000, 5000000}) {
+    auto extent = 2 * std::cbrt(static_cast<float>(entity_count));
+    std::uniform_real_distribution<float> rand_coord(0, extent);
+    ecs::World<Settings> world;
+    Grid grid(2 * kRadius);
+    grid.connect(world);
+    std::vector<EntityId> entities;
+    for (uint64_t i = 0; i < entity_count; i++) {
+      auto e = world.create();
+      auto _ = world.assign<Position>(e, rand_coord(seed), rand_coord(seed), rand_coord(seed));
+      entities.push_back(e);
+    }
+    std::vector<Grid::Sphere> queries;
+    for (uint64_t i = 0; i < kQueryCount; i++) {
+      queries.push_back({rand_coord(seed), rand_coord(seed), rand_coord(seed), kRadius});
+    }
+
+    std::cout << "entities: " << entity_count << "\n";
+    measure("  index all (flush)", 1, [&] { world.flush(); });
+    measure("  rebuild", 1, [&] { grid.rebuild(world); });
+    measure("  move 1% + flush", 10, [&] {
+      for (uint64_t i = 0; i < entity_count / 100; i++) {
+        world.patch<Position>(entities[i * 100], [&](Position &p) { p.x = rand_coord(seed); });
+      }
+      world.flush();
+    });
+    uint64_t found = 0;
+    measure("  grid, 1000 queries", 10, [&] { found = grid.radius(world, queries).ids().size(); });
+    std::cout << "  found per query: " << found / kQueryCount << "\n";
+    measure("  grid, 1000 queries + fetch", 10, [&] {
+      auto result = grid.radius(world, queries);
+      float sum = 0;
+      for (auto &&id : result.ids()) {
+        sum += world.get_ptr<Position>(id)->x;
+      }
+      found = static_cast<uint64_t>(sum) & 1;
+    });
+    measure("  view scan, 10 queries", 1, [&] {
+      for (uint64_t i = 0; i < kBruteForceQueryCount; i++) {
+        auto &&q = queries[i];
+        for (auto &&[p] : world.fuzzy_view<const Position>()) {
+          auto dx = p.x - q.x;
+          auto dy = p.y - q.y;
+          auto dz = p.z - q.z;
+          found += dx * dx + dy * dy + dz * dz <= q.radius * q.radius;
+        }
+      }
+    });
+  }
+}
\ No newline at end of file
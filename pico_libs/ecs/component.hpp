@@ -1,5 +1,29 @@
 #pragma once
+#include <pico_libs/mpl/type_list.hpp>
+#include <type_traits>
+
 namespace xac::ecs {
+// empty component types are tags, they live in the entity mask only and are never yielded by views
+template <typename T>
+struct is_tag : std::is_empty<std::remove_cvref_t<T>> {};
+template <typename T>
+inline constexpr bool is_tag_v = is_tag<T>::value;
+template <typename T>
+struct is_stored : std::bool_constant<!is_tag_v<T>> {};
+
+// types in TSettings::SharedList, many entities may refer to one immutable value
+template <typename TSettings, typename T>
+inline constexpr bool is_shared_v = mpl::contains_v<std::decay_t<T>, typename TSettings::SharedList>;
+
+// types in TSettings::BufferedList, read from the previous tick and written to the current one
+template <typename TSettings, typename T>
+inline constexpr bool is_buffered_v = mpl::contains_v<std::decay_t<T>, typename TSettings::BufferedList>;
+
+// how views and handles refer to a component, shared ones are read only
+template <typename TSettings, typename T>
+using component_ref_t =
+    std::conditional_t<is_shared_v<TSettings, T>, const std::decay_t<T> &, std::remove_reference_t<T> &>;
+
 template <typename TSettings>
 class Entity;
 template <typename TSettings>
@@ -10,14 +34,16 @@ class ComponentHandle {
  public:
   using EntityId = typename Entity<TSettings>::Id;
   using ThisWorld = World<TSettings>;
+  using Ref = component_ref_t<TSettings, T>;
+  using Ptr = std::remove_reference_t<Ref>*;
 
-  auto operator*() -> T& {
+  auto operator*() -> Ref {
     return *world_->template get_ptr<T>(id_);
   }
-  auto operator->() -> T* {
+  auto operator->() -> Ptr {
     return world_->template get_ptr<T>(id_);
   }
-  auto get() -> T* {
+  auto get() -> Ptr {
     return world_->template get_ptr<T>(id_);
   }
 
@@ -7,6 +7,7 @@ namespace xac::ecs {
 template <typename TSettings>
 class World;
 
+// a lightweight handle, the world keeps the entity data itself in separate mask and version arrays
 template <typename TSettings>
 class Entity {
  public:
@@ -18,10 +19,6 @@ class Entity {
     uint64_t version;
   };
   Entity() = default;
-  // Entity(const Entity& e) noexcept = default;
-  // Entity(Entity&& e) noexcept = default;
-  // Entity& operator=(const Entity& e) = default;
-  // Entity& operator=(Entity&& e) noexcept = default;
   Entity(Id id, ThisWorld* world);
 
  public:
@@ -31,14 +28,18 @@ class Entity {
   auto GetWorld() -> ThisWorld* {
     return world_;
   }
-  auto GetComponentsMask() {
-    return components_mask_;
+  auto GetComponentsMask() -> std::bitset<ComponentList::size> {
+    auto&& mask = world_->components_mask_[id_.index];
+    std::bitset<ComponentList::size> components_mask;
+    for (uint64_t i = 0; i < ComponentList::size; i++) {
+      components_mask[i] = mask[i];
+    }
+    return components_mask;
   }
 
  private:
   Id id_;
   ThisWorld* world_ = nullptr;
-  std::bitset<TSettings::ComponentList::size> components_mask_;
 };
 
 template <typename TSettings>
@@ -0,0 +1,9 @@
+#pragma once
+
+namespace xac::ecs {
+// owning group, list it in TSettings::GroupList, a component type can be owned by one group at most
+// entities having all of Ts are kept packed at the front of every Ts pool in the same order,
+// so World::group_view walks the pools in parallel and World::sort reorders all of them at once
+template <typename... Ts>
+struct group {};
+}  // namespace xac::ecs
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace xac::ecs {
+
+struct PoolStats {
+  std::string_view name;
+  uint64_t capacity = 0;  // slots allocated
+  uint64_t size = 0;      // slots holding a live value
+  // a shared pool adds sizeof(T) once per distinct value, what the values own on the heap is never counted
+  uint64_t bytes_reserved = 0;
+  uint64_t bytes_used = 0;
+  // dead slots among the addressable ones (below the entity count), in [0, 1]
+  double fragmentation = 0;
+};
+
+template <uint64_t N>
+struct MemoryStats {
+  PoolStats entities;
+  std::array<PoolStats, N> components;
+
+  auto bytes_reserved() const -> uint64_t {
+    uint64_t bytes = entities.bytes_reserved;
+    for (auto &&pool : components) {
+      bytes += pool.bytes_reserved;
+    }
+    return bytes;
+  }
+  auto bytes_used() const -> uint64_t {
+    uint64_t bytes = entities.bytes_used;
+    for (auto &&pool : components) {
+      bytes += pool.bytes_used;
+    }
+    return bytes;
+  }
+};
+
+}  // namespace xac::ecs
\ No newline at end of file
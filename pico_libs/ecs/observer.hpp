@@ -0,0 +1,60 @@
+#pragma once
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace xac::ecs {
+template <typename TSettings>
+class Entity;
+template <typename TSettings>
+class World;
+
+// events, list them in TSettings::ObserverList to let the world record them
+template <typename T>
+struct on_add {};
+template <typename T>
+struct on_remove {};
+// raised by World::patch and World::emplace_or_replace, not by writes through views or handles
+template <typename T>
+struct on_update {};
+struct on_destroy {};
+
+// collect ids of one kind of event, and hand them to the callbacks as one batch when the world flushes
+// HINT: ids in a batch may be stale, the entity may have been destroyed or lost the component since the event,
+// check them with World::valid and World::has
+template <typename TSettings, typename TEvent>
+class Observer {
+ public:
+  using EntityId = typename Entity<TSettings>::Id;
+  using ThisWorld = World<TSettings>;
+  using Callback = std::function<void(ThisWorld &, std::span<const EntityId>)>;
+
+  auto connect(Callback callback) -> void {
+    callbacks_.push_back(std::move(callback));
+  }
+  auto record(const EntityId &id) -> void {
+    pending_.push_back(id);
+  }
+  auto clear() -> void {
+    pending_.clear();
+  }
+  // take the pending ids as the next batch, the world does it for every observer before dispatching any
+  auto prepare() -> void {
+    std::swap(pending_, flushing_);
+  }
+  auto dispatch(ThisWorld &world) -> void {
+    if (flushing_.empty()) {
+      return;
+    }
+    for (auto &&callback : callbacks_) {
+      std::invoke(callback, world, std::span<const EntityId>{flushing_});
+    }
+    flushing_.clear();
+  }
+
+ private:
+  std::vector<Callback> callbacks_;
+  std::vector<EntityId> pending_;
+  std::vector<EntityId> flushing_;
+};
+}  // namespace xac::ecs
\ No newline at end of file
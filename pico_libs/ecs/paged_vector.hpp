@@ -0,0 +1,148 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace xac::ecs {
+
+// number of T in a page of about 16 KB, a power of two so a position splits into page and offset cheaply
+template <typename T>
+inline constexpr uint64_t kPageSizeOf = std::max<uint64_t>(1, std::bit_floor(16 * 1024 / sizeof(T)));
+
+// pages held by shared pointers, the one place doing copy on write for PagedVector and Pool
+// pages are shared between tables made by share() and copied on the first mutable access from either side
+template <typename TPage>
+class PageTable {
+ public:
+  PageTable() = default;
+  PageTable(const PageTable &) = delete;
+  PageTable(PageTable &&) noexcept = default;
+  auto operator=(const PageTable &) -> PageTable & = delete;
+  auto operator=(PageTable &&) noexcept -> PageTable & = default;
+
+  // O(number of pages), both tables copy a page before writing to it from now on
+  auto share() -> PageTable {
+    static_assert(std::is_copy_constructible_v<TPage>, "only copyable pages can be shared");
+    shared_ = true;
+    PageTable copy;
+    copy.pages_ = pages_;
+    copy.shared_ = true;
+    return copy;
+  }
+  // copy every page still shared, so mut() no longer replaces pages, e.g. before writing from several threads
+  auto detach() -> void {
+    if constexpr (std::is_copy_constructible_v<TPage>) {
+      if (!shared_) {
+        return;
+      }
+      for (auto &&page : pages_) {
+        if (page.use_count() > 1) {
+          page = std::make_shared<TPage>(*page);
+        }
+      }
+      shared_ = false;
+    }
+  }
+
+  auto operator[](uint64_t p) const -> const TPage & {
+    return *pages_[p];
+  }
+  auto mut(uint64_t p) -> TPage & {
+    if constexpr (std::is_copy_constructible_v<TPage>) {
+      if (shared_ && pages_[p].use_count() > 1) {
+        pages_[p] = std::make_shared<TPage>(*pages_[p]);
+      }
+    }
+    return *pages_[p];
+  }
+  auto size() const -> uint64_t {
+    return pages_.size();
+  }
+  auto bytes_reserved() const -> uint64_t {
+    return pages_.size() * sizeof(TPage) + pages_.capacity() * sizeof(std::shared_ptr<TPage>);
+  }
+  auto push_back() -> void {
+    pages_.push_back(std::make_shared<TPage>());
+  }
+
+ private:
+  std::vector<std::shared_ptr<TPage>> pages_;
+  bool shared_ = false;  // set once shared, skips the use count check for tables never shared
+};
+
+// vector split into fixed size pages kept in a PageTable
+template <typename T>
+class PagedVector {
+ public:
+  constexpr static uint64_t kPageSize = kPageSizeOf<T>;
+
+  PagedVector() = default;
+  PagedVector(const PagedVector &) = delete;
+  PagedVector(PagedVector &&) noexcept = default;
+  auto operator=(const PagedVector &) -> PagedVector & = delete;
+  auto operator=(PagedVector &&) noexcept -> PagedVector & = default;
+
+  auto share() -> PagedVector {
+    PagedVector copy;
+    copy.pages_ = pages_.share();
+    copy.size_ = size_;
+    return copy;
+  }
+
+  auto operator[](uint64_t i) const -> const T & {
+    return pages_[i / kPageSize].values[i % kPageSize];
+  }
+  auto mut(uint64_t i) -> T & {
+    return pages_.mut(i / kPageSize).values[i % kPageSize];
+  }
+  auto back() const -> const T & {
+    return (*this)[size_ - 1];
+  }
+  auto size() const -> uint64_t {
+    return size_;
+  }
+  auto empty() const -> bool {
+    return size_ == 0;
+  }
+  auto capacity() const -> uint64_t {
+    return pages_.size() * kPageSize;
+  }
+  auto bytes_reserved() const -> uint64_t {
+    return pages_.bytes_reserved();
+  }
+
+  auto resize(uint64_t size, const T &value = {}) -> void {
+    reserve(size);
+    for (uint64_t i = size_; i < size; i++) {
+      mut(i) = value;
+    }
+    size_ = size;
+  }
+  auto reserve(uint64_t size) -> void {
+    while (capacity() < size) {
+      pages_.push_back();
+    }
+  }
+  auto push_back(const T &value) -> void {
+    reserve(size_ + 1);
+    mut(size_++) = value;
+  }
+  auto pop_back() -> void {
+    size_--;
+  }
+
+ private:
+  struct Page {
+    std::array<T, kPageSize> values{};
+  };
+
+ private:
+  PageTable<Page> pages_;
+  uint64_t size_ = 0;
+};
+
+}  // namespace xac::ecs
\ No newline at end of file
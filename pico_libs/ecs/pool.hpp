@@ -0,0 +1,547 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "paged_vector.hpp"
+
+namespace xac::ecs {
+
+// components are built with braces first, e.g. std::vector<int>{3, 5} holds two values, parentheses build the rest
+// a single value of T itself is always copied or moved
+template <typename T, typename... Args>
+constexpr bool kBraceInit = !(sizeof...(Args) == 1 && (std::is_same_v<std::remove_cvref_t<Args>, T> && ...)) &&
+                            requires { T{std::declval<Args>()...}; };
+
+// sparse set of one component type
+// sparse_ maps an entity index to a position, dense_ and the values are packed and share positions
+// values live in fixed size pages of raw storage, constructed in place and never moved when the pool grows
+// kBuffers values are kept per entity, each buffer in its own page table, plain access goes to buffer 0
+// all pages are in page tables, so pools made by share() copy them on write
+// HINT: once a page is shared, the next mutable access replaces it by a copy, pointers to its values taken before,
+// and const ones, then point into the page still held by the other pool
+template <typename T, uint64_t kBuffers = 1>
+class Pool {
+ public:
+  constexpr static uint64_t kNull = std::numeric_limits<uint64_t>::max();
+  constexpr static uint64_t kPageSize = kPageSizeOf<T>;
+
+  Pool() = default;
+  Pool(const Pool &) = delete;
+  Pool(Pool &&) noexcept = default;
+  auto operator=(const Pool &) -> Pool & = delete;
+  auto operator=(Pool &&) noexcept -> Pool & = default;
+
+  auto share() -> Pool {
+    static_assert(std::is_copy_constructible_v<T>, "only copyable components can be shared");
+    Pool copy;
+    copy.sparse_ = sparse_.share();
+    copy.dense_ = dense_.share();
+    for (uint64_t b = 0; b < kBuffers; b++) {
+      copy.buffers_[b] = buffers_[b].share();
+    }
+    copy.size_ = size_;
+    return copy;
+  }
+  // copy the pages written by mutable access which are still shared, so that access no longer replaces pages
+  auto detach() -> void {
+    buffers_[0].detach();
+  }
+
+  auto contains(uint64_t index) const -> bool {
+    return index < sparse_.size() && sparse_[index] != kNull;
+  }
+  auto position(uint64_t index) const -> uint64_t {
+    return sparse_[index];
+  }
+  auto get(uint64_t index) -> T & {
+    return at(sparse_[index]);
+  }
+  auto cget(uint64_t index) const -> const T & {
+    return cat(sparse_[index]);
+  }
+  auto entity_at(uint64_t pos) const -> uint64_t {
+    return dense_[pos];
+  }
+  auto at(uint64_t pos) -> T & {
+    return *slot(0, pos);
+  }
+  auto cat(uint64_t pos) const -> const T & {
+    return buffer_cat(0, pos);
+  }
+  auto size() const -> uint64_t {
+    return size_;
+  }
+  auto capacity() const -> uint64_t {
+    return buffers_[0].size() * kPageSize;
+  }
+  auto sparse_size() const -> uint64_t {
+    return sparse_.size();
+  }
+  auto bytes_reserved() const -> uint64_t {
+    uint64_t bytes = dense_.bytes_reserved() + sparse_.bytes_reserved();
+    for (auto &&buffer : buffers_) {
+      bytes += buffer.bytes_reserved();
+    }
+    return bytes;
+  }
+  auto bytes_used() const -> uint64_t {
+    return size_ * (kBuffers * sizeof(T) + 2 * sizeof(uint64_t));  // values, dense and sparse entry
+  }
+
+  // make room for size values and entity indices below index_end
+  auto reserve(uint64_t size, uint64_t index_end) -> void {
+    if (index_end > sparse_.size()) {
+      sparse_.resize(std::max(index_end, sparse_.size() * 2), kNull);
+    }
+    while (capacity() < size) {
+      for (auto &&buffer : buffers_) {
+        buffer.push_back();
+      }
+    }
+  }
+  // copy the value of entity src to entity dst
+  auto clone(uint64_t src, uint64_t dst) -> T & {
+    static_assert(std::is_copy_constructible_v<T>, "only copyable components can be cloned");
+    return emplace(dst, cat(sparse_[src]));
+  }
+
+  // the other buffers start with a copy of the value
+  // if a constructor throws the pool is left as it was, apart from the reserved room
+  template <typename... Args>
+  auto emplace(uint64_t index, Args &&...args) -> T & {
+    if (index >= sparse_.size()) {
+      sparse_.resize(std::max(index + 1, sparse_.size() * 2), kNull);
+    }
+    reserve(size_ + 1, 0);
+    auto *value = construct(slot(0, size_), std::forward<Args>(args)...);
+    if constexpr (kBuffers > 1) {
+      uint64_t b = 1;
+      try {
+        for (; b < kBuffers; b++) {
+          construct(slot(b, size_), std::as_const(*value));
+        }
+      } catch (...) {
+        while (b-- > 0) {
+          std::destroy_at(slot(b, size_));
+        }
+        throw;
+      }
+    }
+    for (auto &&buffer : buffers_) {
+      buffer.mut(size_ / kPageSize).live++;
+    }
+    dense_.push_back(index);
+    sparse_.mut(index) = size_++;
+    return *value;
+  }
+  template <typename... Args>
+  auto replace(uint64_t index, Args &&...args) -> T & {
+    return assign(get(index), std::forward<Args>(args)...);
+  }
+  // move the last one into the hole, so positions before pos are kept
+  auto remove(uint64_t index) -> void {
+    auto pos = sparse_[index];
+    auto last = size_ - 1;
+    for (uint64_t b = 0; b < kBuffers; b++) {
+      if (pos != last) {
+        if constexpr (std::is_move_assignable_v<T>) {
+          *slot(b, pos) = std::move(*slot(b, last));
+        } else {
+          std::destroy_at(slot(b, pos));
+          construct(slot(b, pos), std::move(*slot(b, last)));
+        }
+      }
+      std::destroy_at(slot(b, last));
+      buffers_[b].mut(last / kPageSize).live--;
+    }
+    if (pos != last) {
+      auto moved = dense_[last];
+      dense_.mut(pos) = moved;
+      sparse_.mut(moved) = pos;
+    }
+    sparse_.mut(index) = kNull;
+    dense_.pop_back();
+    size_--;
+  }
+  auto swap_positions(uint64_t lhs, uint64_t rhs) -> void {
+    if (lhs == rhs) {
+      return;
+    }
+    using std::swap;
+    for (uint64_t b = 0; b < kBuffers; b++) {
+      swap(*slot(b, lhs), *slot(b, rhs));
+    }
+    auto lhs_index = dense_[lhs];
+    auto rhs_index = dense_[rhs];
+    dense_.mut(lhs) = rhs_index;
+    dense_.mut(rhs) = lhs_index;
+    sparse_.mut(rhs_index) = lhs;
+    sparse_.mut(lhs_index) = rhs;
+  }
+  // move the given entities to [first, first + entities.size()) in order, they must all be at or after first
+  auto arrange(uint64_t first, std::span<const uint64_t> entities) -> void {
+    for (uint64_t i = 0; i < entities.size(); i++) {
+      swap_positions(first + i, sparse_[entities[i]]);
+    }
+  }
+  // sort positions [first, last) by compare(const T &, const T &), return the entity order for co-sorting
+  template <typename Compare>
+  auto sort(uint64_t first, uint64_t last, Compare compare) -> std::vector<uint64_t> {
+    auto order = sort_order(first, last, [&](uint64_t lhs, uint64_t rhs) {
+      return std::invoke(compare, cat(lhs), cat(rhs));
+    });
+    arrange(first, order);
+    return order;
+  }
+
+ protected:
+  auto buffer_at(uint64_t b, uint64_t pos) -> T & {
+    return *slot(b, pos);
+  }
+  auto buffer_cat(uint64_t b, uint64_t pos) const -> const T & {
+    return *std::launder(reinterpret_cast<const T *>(buffers_[b][pos / kPageSize].bytes) + pos % kPageSize);
+  }
+  auto detach_buffer(uint64_t b) -> void {
+    buffers_[b].detach();
+  }
+  // entities of positions [first, last) in the order of less(pos, pos), to be passed to arrange()
+  template <typename Less>
+  auto sort_order(uint64_t first, uint64_t last, Less less) const -> std::vector<uint64_t> {
+    std::vector<uint64_t> order(last - first);
+    std::iota(order.begin(), order.end(), first);
+    std::sort(order.begin(), order.end(), less);
+    for (auto &&pos : order) {
+      pos = dense_[pos];
+    }
+    return order;
+  }
+  template <typename... Args>
+  static auto assign(T &value, Args &&...args) -> T & {
+    if constexpr (sizeof...(Args) == 1 && (std::is_same_v<std::remove_cvref_t<Args>, T> && ...)) {
+      value = (std::forward<Args>(args), ...);
+    } else if constexpr (kBraceInit<T, Args...>) {
+      value = T{std::forward<Args>(args)...};
+    } else {
+      value = T(std::forward<Args>(args)...);
+    }
+    return value;
+  }
+
+ private:
+  // destroys its live values, which are always the first ones
+  struct Page {
+    alignas(T) std::byte bytes[kPageSize * sizeof(T)];
+    uint64_t live = 0;
+
+    Page() = default;
+    Page(const Page &other)
+      requires std::is_copy_constructible_v<T>
+        : live(other.live) {
+      std::uninitialized_copy_n(std::launder(reinterpret_cast<const T *>(other.bytes)), live, reinterpret_cast<T *>(bytes));
+    }
+    ~Page() {
+      std::destroy_n(std::launder(reinterpret_cast<T *>(bytes)), live);
+    }
+  };
+
+  auto slot(uint64_t b, uint64_t pos) -> T * {
+    return std::launder(reinterpret_cast<T *>(buffers_[b].mut(pos / kPageSize).bytes) + pos % kPageSize);
+  }
+  template <typename... Args>
+  static auto construct(T *p, Args &&...args) -> T * {
+    if constexpr (kBraceInit<T, Args...>) {
+      return ::new (static_cast<void *>(p)) T{std::forward<Args>(args)...};
+    } else {
+      return ::new (static_cast<void *>(p)) T(std::forward<Args>(args)...);
+    }
+  }
+
+ private:
+  PagedVector<uint64_t> sparse_;
+  PagedVector<uint64_t> dense_;
+  std::array<PageTable<Page>, kBuffers> buffers_;
+  uint64_t size_ = 0;
+};
+
+// tags have no column, the entity mask tells who has one, only the count is kept here
+template <typename T>
+  requires std::is_empty_v<T>
+class Pool<T, 1> {
+ public:
+  auto get(uint64_t) -> T & {
+    return instance_;
+  }
+  auto cget(uint64_t) const -> const T & {
+    return instance_;
+  }
+  auto size() const -> uint64_t {
+    return size_;
+  }
+  auto capacity() const -> uint64_t {
+    return 0;
+  }
+  auto sparse_size() const -> uint64_t {
+    return 0;
+  }
+  auto bytes_reserved() const -> uint64_t {
+    return 0;
+  }
+  auto bytes_used() const -> uint64_t {
+    return 0;
+  }
+  auto reserve(uint64_t, uint64_t) -> void {}
+  auto clone(uint64_t, uint64_t dst) -> T & {
+    return emplace(dst);
+  }
+  auto share() -> Pool {
+    Pool copy;
+    copy.size_ = size_;
+    return copy;
+  }
+  auto detach() -> void {}
+  template <typename... Args>
+  auto emplace(uint64_t, Args &&...) -> T & {
+    size_++;
+    return instance_;
+  }
+  template <typename... Args>
+  auto replace(uint64_t, Args &&...) -> T & {
+    return instance_;
+  }
+  auto remove(uint64_t) -> void {
+    size_--;
+  }
+
+ private:
+  inline static T instance_{};
+  uint64_t size_ = 0;
+};
+
+// pool of a shared component, entities hold a reference to an immutable value
+// entities assigned from the same std::shared_ptr, or cloned from each other, share one value
+// the entities holding each value are counted, so memory stats count every distinct value once
+template <typename T>
+class SharedPool : public Pool<std::shared_ptr<const T>> {
+  using Base = Pool<std::shared_ptr<const T>>;
+  using Handle = std::shared_ptr<const T>;
+
+ public:
+  SharedPool() = default;
+  SharedPool(Base &&base) : Base(std::move(base)) {}
+
+  // also copies the counts, O(number of distinct values)
+  auto share() -> SharedPool {
+    SharedPool copy = Base::share();
+    copy.values_ = values_;
+    return copy;
+  }
+  auto bytes_reserved() const -> uint64_t {
+    return Base::bytes_reserved() + values_.size() * sizeof(T);
+  }
+  auto bytes_used() const -> uint64_t {
+    return Base::bytes_used() + values_.size() * sizeof(T);
+  }
+  auto get(uint64_t index) -> const T & {
+    return *Base::cget(index);
+  }
+  auto cget(uint64_t index) const -> const T & {
+    return *Base::cget(index);
+  }
+  auto at(uint64_t pos) -> const T & {
+    return *Base::cat(pos);
+  }
+  auto cat(uint64_t pos) const -> const T & {
+    return *Base::cat(pos);
+  }
+  auto handle(uint64_t index) const -> const Handle & {
+    return Base::cget(index);
+  }
+  auto clone(uint64_t src, uint64_t dst) -> const T & {
+    return emplace(dst, handle(src));
+  }
+  template <typename... Args>
+  auto emplace(uint64_t index, Args &&...args) -> const T & {
+    auto &&value = Base::emplace(index, make(std::forward<Args>(args)...));
+    values_[value.get()]++;
+    return *value;
+  }
+  template <typename... Args>
+  auto replace(uint64_t index, Args &&...args) -> const T & {
+    auto value = make(std::forward<Args>(args)...);
+    values_[value.get()]++;
+    release(handle(index).get());
+    return *Base::replace(index, std::move(value));
+  }
+  auto remove(uint64_t index) -> void {
+    release(handle(index).get());
+    Base::remove(index);
+  }
+  template <typename Compare>
+  auto sort(uint64_t first, uint64_t last, Compare compare) -> std::vector<uint64_t> {
+    return Base::sort(first, last, [&](const Handle &lhs, const Handle &rhs) {
+      return std::invoke(compare, *lhs, *rhs);
+    });
+  }
+
+ private:
+  auto release(const T *value) -> void {
+    if (auto it = values_.find(value); --it->second == 0) {
+      values_.erase(it);
+    }
+  }
+  template <typename... Args>
+  static auto make(Args &&...args) -> Handle {
+    if constexpr (sizeof...(Args) == 1 && (std::is_convertible_v<Args, Handle> && ...)) {
+      return (std::forward<Args>(args), ...);
+    } else if constexpr (kBraceInit<T, Args...>) {
+      return Handle(new T{std::forward<Args>(args)...});
+    } else {
+      return std::make_shared<const T>(std::forward<Args>(args)...);
+    }
+  }
+
+ private:
+  std::unordered_map<const T *, uint64_t> values_;  // entities holding each value
+};
+
+// pool of a double buffered component, every value is kept in two buffers, each in its own page table
+// const access reads the values as of the last swap and mutable access writes the newest ones in the other buffer,
+// so a reader and a writer of the same type touch different pages within a tick
+// each page is stamped with the tick it was last written in and the buffer holding its newest values, the first
+// write to a page in a tick copies them forward, so values not written are still read after any number of swaps
+// HINT: call detach() before writing from several threads, afterwards no access copies a page or a stamp
+template <typename T>
+class BufferedPool : public Pool<T, 2> {
+  static_assert(!std::is_empty_v<T>, "tags can not be double buffered");
+  static_assert(std::is_copy_constructible_v<T>, "only copyable components can be double buffered");
+  using Base = Pool<T, 2>;
+  using Base::kPageSize;
+
+ public:
+  BufferedPool() = default;
+  BufferedPool(Base &&base, uint64_t tick, std::vector<uint64_t> stamps)
+      : Base(std::move(base)), tick_(tick), stamps_(std::move(stamps)) {}
+
+  auto share() -> BufferedPool {
+    return {Base::share(), tick_, stamps_};
+  }
+  auto detach() -> void {
+    for (uint64_t p = 0; p * kPageSize < Base::size(); p++) {
+      write_buffer(p);
+    }
+    Base::detach_buffer(0);
+    Base::detach_buffer(1);
+  }
+  // O(1), values written this tick become the ones read
+  auto swap() -> void {
+    tick_++;
+  }
+  auto get(uint64_t index) -> T & {
+    return at(Base::position(index));
+  }
+  auto cget(uint64_t index) const -> const T & {
+    return cat(Base::position(index));
+  }
+  auto at(uint64_t pos) -> T & {
+    return Base::buffer_at(write_buffer(pos / kPageSize), pos);
+  }
+  auto cat(uint64_t pos) const -> const T & {
+    return Base::buffer_cat(read_buffer(pos / kPageSize), pos);
+  }
+  auto bytes_reserved() const -> uint64_t {
+    return Base::bytes_reserved() + stamps_.capacity() * sizeof(uint64_t);
+  }
+  auto clone(uint64_t src, uint64_t dst) -> T & {
+    return emplace(dst, newest(Base::position(src)));
+  }
+  // both buffers start with the same value
+  template <typename... Args>
+  auto emplace(uint64_t index, Args &&...args) -> T & {
+    if (auto p = Base::size() / kPageSize; p >= stamps_.size()) {
+      stamps_.resize(std::max(p + 1, stamps_.size() * 2));
+    }
+    Base::emplace(index, std::forward<Args>(args)...);
+    return get(index);
+  }
+  template <typename... Args>
+  auto replace(uint64_t index, Args &&...args) -> T & {
+    return Base::assign(get(index), std::forward<Args>(args)...);
+  }
+  auto remove(uint64_t index) -> void {
+    align(Base::size() - 1, Base::position(index));
+    Base::remove(index);
+  }
+  auto swap_positions(uint64_t lhs, uint64_t rhs) -> void {
+    align(lhs, rhs);
+    align(rhs, lhs);
+    Base::swap_positions(lhs, rhs);
+  }
+  auto arrange(uint64_t first, std::span<const uint64_t> entities) -> void {
+    for (uint64_t i = 0; i < entities.size(); i++) {
+      swap_positions(first + i, Base::position(entities[i]));
+    }
+  }
+  template <typename Compare>
+  auto sort(uint64_t first, uint64_t last, Compare compare) -> std::vector<uint64_t> {
+    auto order = Base::sort_order(first, last, [&](uint64_t lhs, uint64_t rhs) {
+      return std::invoke(compare, newest(lhs), newest(rhs));
+    });
+    arrange(first, order);
+    return order;
+  }
+
+ private:
+  // a stamp is tick << 1 | buffer, loaded and stored atomically as readers may run beside a writer
+  auto stamp(uint64_t p) const -> uint64_t {
+    return std::atomic_ref<uint64_t>(const_cast<uint64_t &>(stamps_[p])).load(std::memory_order_relaxed);
+  }
+  auto read_buffer(uint64_t p) const -> uint64_t {
+    auto s = stamp(p);
+    return (s & 1) ^ uint64_t{s >> 1 == tick_};
+  }
+  auto newest(uint64_t pos) const -> const T & {
+    return Base::buffer_cat(stamp(pos / kPageSize) & 1, pos);
+  }
+  // the first write to a page in a tick copies its newest values into the buffer not read in this tick
+  auto write_buffer(uint64_t p) -> uint64_t {
+    auto s = stamp(p);
+    auto newest = s & 1;
+    if (s >> 1 == tick_) {
+      return newest;
+    }
+    auto last = std::min(Base::size(), (p + 1) * kPageSize);
+    for (auto pos = p * kPageSize; pos < last; pos++) {
+      Base::buffer_at(newest ^ 1, pos) = Base::buffer_cat(newest, pos);
+    }
+    std::atomic_ref<uint64_t>(stamps_[p]).store(tick_ << 1 | (newest ^ 1), std::memory_order_relaxed);
+    return newest ^ 1;
+  }
+  // before the value at pos moves to the page of dst, lay it out in the buffers the way that page does
+  auto align(uint64_t pos, uint64_t dst) -> void {
+    auto p = pos / kPageSize;
+    auto q = dst / kPageSize;
+    if (p != q && write_buffer(p) != write_buffer(q)) {
+      using std::swap;
+      swap(Base::buffer_at(0, pos), Base::buffer_at(1, pos));
+    }
+  }
+
+ private:
+  uint64_t tick_ = 0;
+  std::vector<uint64_t> stamps_;  // by page
+};
+
+}  // namespace xac::ecs
\ No newline at end of file
@@ -0,0 +1,251 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace xac::ecs {
+
+struct ViewCounters {
+  uint64_t iterations = 0;  // times begin() is called
+  uint64_t scanned = 0;     // entity slots visited
+  uint64_t matched = 0;     // entity slots yielded
+  uint64_t time_ns = 0;     // lifetime of the view objects
+};
+
+struct PoolCounters {
+  uint64_t reallocations = 0;
+  uint64_t bytes_allocated = 0;  // current size of the backing buffer
+};
+
+struct ScopeCounters {
+  uint64_t calls = 0;
+  uint64_t time_ns = 0;
+};
+
+struct Counters {
+  std::map<std::string, ViewCounters, std::less<>> views;
+  std::map<std::string, PoolCounters, std::less<>> pools;
+  std::map<std::string, ScopeCounters, std::less<>> scopes;
+};
+
+// copies of one view may be iterated from several threads at once
+inline auto add_count(uint64_t &counter, uint64_t n) -> void {
+  std::atomic_ref<uint64_t>(counter).fetch_add(n, std::memory_order_relaxed);
+}
+
+// enabled by TSettings::kEnableProfiling, collects counters and a timeline exportable as chrome trace json
+// scopes and views may be created and ended from several threads, read counters() once they are joined
+class Profiler {
+  using Clock = std::chrono::steady_clock;
+
+  struct TraceEvent {
+    std::string_view name;  // HINT: points to a key of counters_, map nodes never move
+    std::string_view category;
+    char phase;
+    int64_t ts_ns = 0;
+    int64_t dur_ns = 0;
+    uint64_t arg0 = 0;
+    uint64_t arg1 = 0;
+    uint64_t tid = thread_index();
+  };
+
+ public:
+  // time a block of code, e.g. a system update, until it goes out of scope
+  class Scope {
+   public:
+    Scope(Profiler *profiler, std::string_view name)
+        : profiler_(profiler), start_(Clock::now()), tid_(thread_index()) {
+      std::tie(name_, counters_) = profiler_->find_or_create(profiler_->counters_.scopes, name);
+    }
+    Scope(Scope &&other) noexcept
+        : profiler_(other.profiler_),
+          name_(other.name_),
+          counters_(other.counters_),
+          start_(other.start_),
+          tid_(other.tid_) {
+      other.profiler_ = nullptr;
+    }
+    Scope(const Scope &) = delete;
+    auto operator=(const Scope &) -> Scope & = delete;
+    auto operator=(Scope &&) -> Scope & = delete;
+    ~Scope() {
+      if (profiler_ == nullptr) {
+        return;
+      }
+      auto [ts, dur] = profiler_->elapsed(start_);
+      std::lock_guard lock(profiler_->mutex_);
+      counters_->calls++;
+      counters_->time_ns += dur;
+      profiler_->events_.push_back({name_, "scope", 'X', ts, dur, 0, 0, tid_});
+    }
+
+   private:
+    Profiler *profiler_;
+    std::string_view name_;
+    ScopeCounters *counters_;
+    Clock::time_point start_;
+    uint64_t tid_;
+  };
+
+  // owned by a view, counters() are its own and bumped by the view iterators
+  // they are added to the counters of the name when the scope ends, so each event counts only its own work
+  class ViewScope {
+   public:
+    ViewScope(Profiler *profiler, std::string_view name)
+        : profiler_(profiler), start_(Clock::now()), tid_(thread_index()) {
+      std::tie(name_, counters_) = profiler_->find_or_create(profiler_->counters_.views, name);
+    }
+    ViewScope(ViewScope &&other) noexcept
+        : profiler_(other.profiler_),
+          name_(other.name_),
+          counters_(other.counters_),
+          start_(other.start_),
+          tid_(other.tid_),
+          local_(other.local_) {
+      other.profiler_ = nullptr;
+    }
+    ViewScope(const ViewScope &) = delete;
+    auto operator=(const ViewScope &) -> ViewScope & = delete;
+    // swap, so the scope held before ends with other
+    auto operator=(ViewScope &&other) noexcept -> ViewScope & {
+      std::swap(profiler_, other.profiler_);
+      std::swap(name_, other.name_);
+      std::swap(counters_, other.counters_);
+      std::swap(start_, other.start_);
+      std::swap(tid_, other.tid_);
+      std::swap(local_, other.local_);
+      return *this;
+    }
+    ~ViewScope() {
+      if (profiler_ == nullptr) {
+        return;
+      }
+      auto [ts, dur] = profiler_->elapsed(start_);
+      std::lock_guard lock(profiler_->mutex_);
+      counters_->iterations += local_.iterations;
+      counters_->scanned += local_.scanned;
+      counters_->matched += local_.matched;
+      counters_->time_ns += dur;
+      profiler_->events_.push_back({name_, "view", 'X', ts, dur, local_.scanned, local_.matched, tid_});
+    }
+    auto counters() -> ViewCounters * {
+      return &local_;
+    }
+
+   private:
+    Profiler *profiler_;
+    std::string_view name_;
+    ViewCounters *counters_;  // of the name, guarded by the mutex of the profiler
+    Clock::time_point start_;
+    uint64_t tid_;
+    ViewCounters local_;
+  };
+
+  Profiler() : epoch_(Clock::now()) {}
+  // the mutex is not moved, no scope or view should be alive when moving
+  Profiler(Profiler &&other) noexcept
+      : counters_(std::move(other.counters_)), events_(std::move(other.events_)), epoch_(other.epoch_) {}
+  auto operator=(Profiler &&other) noexcept -> Profiler & {
+    counters_ = std::move(other.counters_);
+    events_ = std::move(other.events_);
+    epoch_ = other.epoch_;
+    return *this;
+  }
+
+  [[nodiscard]] auto scope(std::string_view name) -> Scope {
+    return {this, name};
+  }
+  [[nodiscard]] auto view_scope(std::string_view name) -> ViewScope {
+    return {this, name};
+  }
+  auto record_pool_growth(std::string_view name, uint64_t bytes_allocated) -> void {
+    auto [key, pool] = find_or_create(counters_.pools, name);
+    std::lock_guard lock(mutex_);
+    pool->reallocations++;
+    pool->bytes_allocated = bytes_allocated;
+    auto [ts, _] = elapsed(Clock::now());
+    events_.push_back({key, "pool", 'C', ts, 0, bytes_allocated});
+  }
+
+  auto counters() const -> const Counters & {
+    return counters_;
+  }
+  // HINT: no scope or view should be alive when clearing
+  auto clear() -> void {
+    counters_ = {};
+    events_.clear();
+  }
+
+  // https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+  auto write_chrome_trace(std::ostream &os) const -> void {
+    os << "{\"traceEvents\":[";
+    for (uint64_t i = 0; i < events_.size(); i++) {
+      auto &&e = events_[i];
+      os << (i == 0 ? "" : ",") << "\n{\"name\":\"";
+      write_json_string(os, e.name);
+      os << "\",\"cat\":\"" << e.category << "\",\"ph\":\"" << e.phase;
+      os << "\",\"pid\":0,\"tid\":" << e.tid << ",\"ts\":" << e.ts_ns / 1000.0;
+      if (e.phase == 'X') {
+        os << ",\"dur\":" << e.dur_ns / 1000.0;
+      }
+      if (e.category == "view") {
+        os << ",\"args\":{\"scanned\":" << e.arg0 << ",\"matched\":" << e.arg1 << "}";
+      } else if (e.category == "pool") {
+        os << ",\"args\":{\"bytes\":" << e.arg0 << "}";
+      }
+      os << "}";
+    }
+    os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+  }
+
+ private:
+  template <typename T>
+  auto find_or_create(std::map<std::string, T, std::less<>> &map, std::string_view name)
+      -> std::pair<std::string_view, T *> {
+    std::lock_guard lock(mutex_);
+    auto it = map.find(name);
+    if (it == map.end()) {
+      it = map.emplace(std::string{name}, T{}).first;
+    }
+    return {it->first, &it->second};
+  }
+  // names are user strings, escape what json does not allow inside a string
+  static auto write_json_string(std::ostream &os, std::string_view str) -> void {
+    constexpr char kHex[] = "0123456789abcdef";
+    for (unsigned char c : str) {
+      if (c == '"' || c == '\\') {
+        os << '\\' << c;
+      } else if (c < 0x20) {
+        os << "\\u00" << kHex[c >> 4] << kHex[c & 0xf];
+      } else {
+        os << c;
+      }
+    }
+  }
+  // small numbers in the order threads first record something, the main thread is usually 0
+  static auto thread_index() -> uint64_t {
+    static std::atomic<uint64_t> next{0};
+    thread_local uint64_t index = next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+  }
+  auto elapsed(Clock::time_point start) const -> std::pair<int64_t, int64_t> {
+    auto ns = [](auto d) { return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(); };
+    return {ns(start - epoch_), ns(Clock::now() - start)};
+  }
+
+ private:
+  Counters counters_;
+  std::vector<TraceEvent> events_;
+  Clock::time_point epoch_;
+  std::mutex mutex_;  // guards the maps of counters_ and events_
+};
+
+}  // namespace xac::ecs
\ No newline at end of file
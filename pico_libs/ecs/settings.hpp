@@ -2,9 +2,23 @@
 #include <pico_libs/mpl/type_list.hpp>
 
 namespace xac::ecs {
+// derive from it and shadow the members below to customize a world
 template <typename TComponentList>
 struct Settings {
+  // move only components can be assigned, but a world holding one can not be forked or restored
   using ComponentList = TComponentList;
+  // events recorded by the world, e.g. mpl::type_list<on_add<Position>, on_destroy>
+  using ObserverList = mpl::type_list<>;
+  // owning groups, e.g. mpl::type_list<group<Position, Velocity>>
+  using GroupList = mpl::type_list<>;
+  // components held by reference, entities made by World::instantiate or assigned the same std::shared_ptr
+  // share one value, no deduplication by value is done, read only through views and handles
+  using SharedList = mpl::type_list<>;
+  // components with a previous and a current value, const views read the values as of the last
+  // World::swap_buffers() and mutable views write the current ones, values not written carry over
+  using BufferedList = mpl::type_list<>;
+  // record view, pool and scope statistics into World::profiler()
+  constexpr static bool kEnableProfiling = false;
   template <typename T>
   constexpr static auto has_component() -> bool {
     return mpl::contains<T, ComponentList>::value;
@@ -0,0 +1,283 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "world.hpp"
+
+namespace xac::ecs {
+
+// uniform grid over the TPosition component, which has x, y and z members, keyed by entity id
+// connect() keeps it in sync from the on_add, on_update, on_remove and on_destroy events of TPosition
+// HINT: writes through views raise no event, report them with update() or World::patch
+// HINT: World::restore raises no event either, call rebuild() after restoring a snapshot
+template <typename TSettings, typename TPosition>
+class SpatialGrid {
+  // cell coordinates are packed into 21 bits each, cells further apart alias and only cost extra tests
+  constexpr static int64_t kCellBias = int64_t{1} << 20;
+  constexpr static uint64_t kCellMask = (uint64_t{1} << 21) - 1;
+  constexpr static uint64_t kNull = std::numeric_limits<uint64_t>::max();
+  constexpr static int64_t kCellLimit = int64_t{1} << 52;
+
+ public:
+  using EntityId = typename Entity<TSettings>::Id;
+  using ThisWorld = World<TSettings>;
+
+  struct Sphere {
+    float x;
+    float y;
+    float z;
+    float radius;
+  };
+  struct Aabb {
+    float min_x;
+    float min_y;
+    float min_z;
+    float max_x;
+    float max_y;
+    float max_z;
+  };
+
+  // ids found by a batch of queries, packed one query after another
+  // ids of one query are in the order of the TPosition pool, so fetching their positions walks it forward
+  // HINT: the order holds until the pool is next reordered, by removals, group packing or World::sort
+  class QueryResult {
+   public:
+    auto size() const -> uint64_t {
+      return offsets_.size() - 1;
+    }
+    auto operator[](uint64_t query) const -> std::span<const EntityId> {
+      return {ids_.data() + offsets_[query], ids_.data() + offsets_[query + 1]};
+    }
+    auto ids() const -> std::span<const EntityId> {
+      return ids_;
+    }
+
+   private:
+    friend class SpatialGrid;
+    std::vector<EntityId> ids_;
+    std::vector<uint64_t> offsets_{0};
+  };
+
+  explicit SpatialGrid(float cell_size) : cell_size_(cell_size) {}
+
+  // all four events of TPosition must be in TSettings::ObserverList, they are handled on World::flush
+  // HINT: the grid must outlive the world, and not move, once connected
+  auto connect(ThisWorld &world) -> void {
+    auto callback = [this](ThisWorld &world, std::span<const EntityId> ids) { update(world, ids); };
+    world.template observe<on_add<TPosition>>(callback);
+    world.template observe<on_update<TPosition>>(callback);
+    world.template observe<on_remove<TPosition>>(callback);
+    world.template observe<on_destroy>(callback);
+  }
+  // index every entity with TPosition from scratch
+  auto rebuild(ThisWorld &world) -> void {
+    cells_.clear();
+    slots_.clear();
+    size_ = 0;
+    auto view = world.template fuzzy_view<Read>();
+    for (auto it = view.begin(); it != view.end(); ++it) {
+      auto &&[position] = *it;
+      insert(it.id(), position);
+    }
+  }
+  // move the given entities to the cells of their current positions, and drop the ones without TPosition
+  // ids may be stale or repeated, the order of events in a batch does not matter
+  auto update(ThisWorld &world, std::span<const EntityId> ids) -> void {
+    for (auto &&id : ids) {
+      auto *slot = find_slot(id.index);
+      bool occupied = slot != nullptr && slot->cell != kNull;
+      bool indexed = occupied && slot->version == id.version;
+      if (!world.alive(id) || !world.template has<TPosition>(id)) {  // prefabs are not indexed, like in views
+        if (indexed) {
+          erase(id.index);
+        }
+        continue;
+      }
+      auto &&position = read(world, id);
+      if (indexed && slot->cell == cell_key(position)) {
+        auto &&entry = cells_.find(slot->cell)->second[slot->pos];
+        entry.x = static_cast<float>(position.x);
+        entry.y = static_cast<float>(position.y);
+        entry.z = static_cast<float>(position.z);
+        continue;
+      }
+      if (occupied) {
+        erase(id.index);  // moved to another cell, or a stale entity reusing the index
+      }
+      insert(id, position);
+    }
+  }
+
+  auto radius(const ThisWorld &world, std::span<const Sphere> queries) const -> QueryResult {
+    QueryResult result;
+    std::vector<std::pair<uint64_t, EntityId>> keyed;
+    for (auto &&q : queries) {
+      auto r2 = q.radius * q.radius;
+      Aabb box{q.x - q.radius, q.y - q.radius, q.z - q.radius, q.x + q.radius, q.y + q.radius, q.z + q.radius};
+      visit(box, result.ids_, [&](const Entry &e) {
+        auto dx = e.x - q.x;
+        auto dy = e.y - q.y;
+        auto dz = e.z - q.z;
+        return dx * dx + dy * dy + dz * dz <= r2;
+      });
+      finish(world, result, keyed);
+    }
+    return result;
+  }
+  auto aabb(const ThisWorld &world, std::span<const Aabb> queries) const -> QueryResult {
+    QueryResult result;
+    std::vector<std::pair<uint64_t, EntityId>> keyed;
+    for (auto &&q : queries) {
+      visit(q, result.ids_, [&](const Entry &e) {
+        return e.x >= q.min_x && e.x <= q.max_x && e.y >= q.min_y && e.y <= q.max_y && e.z >= q.min_z &&
+               e.z <= q.max_z;
+      });
+      finish(world, result, keyed);
+    }
+    return result;
+  }
+
+  // number of indexed entities
+  auto size() const -> uint64_t {
+    return size_;
+  }
+  auto cell_count() const -> uint64_t {
+    return cells_.size();
+  }
+  auto cell_size() const -> float {
+    return cell_size_;
+  }
+
+ private:
+  // positions are copied into the cells, so queries never touch the world
+  struct Entry {
+    float x;
+    float y;
+    float z;
+    EntityId id;
+  };
+  struct Slot {
+    uint64_t cell = kNull;
+    uint64_t pos = 0;
+    uint64_t version = 0;
+  };
+
+  // read only, so pages shared with a fork are not copied, except a double buffered position which is read
+  // from the buffer just written
+  using Read = std::conditional_t<is_buffered_v<TSettings, TPosition>, TPosition, const TPosition>;
+  static auto read(ThisWorld &world, const EntityId &id) -> const TPosition & {
+    if constexpr (is_buffered_v<TSettings, TPosition>) {
+      return *world.template get_ptr<TPosition>(id);
+    } else {
+      return *std::as_const(world).template get_ptr<TPosition>(id);
+    }
+  }
+
+  // in double and clamped, so huge or infinite values convert, far cells alias anyway
+  auto cell_coord(float v) const -> int64_t {
+    constexpr auto limit = static_cast<double>(kCellLimit);
+    auto c = std::floor(static_cast<double>(v) / cell_size_);
+    return std::isnan(c) ? 0 : static_cast<int64_t>(std::clamp(c, -limit, limit));
+  }
+  static auto pack(int64_t x, int64_t y, int64_t z) -> uint64_t {
+    auto bits = [](int64_t v) { return static_cast<uint64_t>(v + kCellBias) & kCellMask; };
+    return bits(x) | bits(y) << 21 | bits(z) << 42;
+  }
+  auto cell_key(const TPosition &p) const -> uint64_t {
+    return pack(cell_coord(p.x), cell_coord(p.y), cell_coord(p.z));
+  }
+  auto find_slot(uint64_t index) -> Slot * {
+    return index < slots_.size() ? &slots_[index] : nullptr;
+  }
+
+  auto insert(const EntityId &id, const TPosition &p) -> void {
+    if (id.index >= slots_.size()) {
+      slots_.resize(std::max(id.index + 1, slots_.size() * 2));
+    }
+    auto key = cell_key(p);
+    auto &cell = cells_[key];
+    slots_[id.index] = {key, cell.size(), id.version};
+    cell.push_back({static_cast<float>(p.x), static_cast<float>(p.y), static_cast<float>(p.z), id});
+    size_++;
+  }
+  // move the last entry of the cell into the hole, drop the cell once empty
+  auto erase(uint64_t index) -> void {
+    auto &slot = slots_[index];
+    auto it = cells_.find(slot.cell);
+    auto &cell = it->second;
+    if (slot.pos != cell.size() - 1) {
+      cell[slot.pos] = cell.back();
+      slots_[cell[slot.pos].id.index].pos = slot.pos;
+    }
+    cell.pop_back();
+    if (cell.empty()) {
+      cells_.erase(it);
+    }
+    slot = {};
+    size_--;
+  }
+
+  // test the entries of every cell overlapping the box, walking the occupied cells instead when that is fewer
+  // or when the box spans enough cells on an axis for their keys to alias, which would yield ids twice
+  template <typename Pred>
+  auto visit(const Aabb &box, std::vector<EntityId> &out, Pred &&pred) const -> void {
+    auto x0 = cell_coord(box.min_x);
+    auto y0 = cell_coord(box.min_y);
+    auto z0 = cell_coord(box.min_z);
+    auto x1 = cell_coord(box.max_x);
+    auto y1 = cell_coord(box.max_y);
+    auto z1 = cell_coord(box.max_z);
+    auto collect = [&](const std::vector<Entry> &cell) {
+      for (auto &&e : cell) {
+        if (pred(e)) {
+          out.push_back(e.id);
+        }
+      }
+    };
+    auto span = std::max({x1 - x0, y1 - y0, z1 - z0});
+    auto range = static_cast<double>(x1 - x0 + 1) * static_cast<double>(y1 - y0 + 1) * static_cast<double>(z1 - z0 + 1);
+    if (span >= static_cast<int64_t>(kCellMask) || range > static_cast<double>(cells_.size())) {
+      for (auto &&[_, cell] : cells_) {
+        collect(cell);
+      }
+      return;
+    }
+    for (auto z = z0; z <= z1; z++) {
+      for (auto y = y0; y <= y1; y++) {
+        for (auto x = x0; x <= x1; x++) {
+          if (auto it = cells_.find(pack(x, y, z)); it != cells_.end()) {
+            collect(it->second);
+          }
+        }
+      }
+    }
+  }
+  // sort the ids of the last query by their position in the TPosition pool, looked up once per id
+  static auto finish(
+      const ThisWorld &world, QueryResult &result, std::vector<std::pair<uint64_t, EntityId>> &keyed
+  ) -> void {
+    auto first = result.ids_.begin() + result.offsets_.back();
+    keyed.clear();
+    for (auto it = first; it != result.ids_.end(); ++it) {
+      keyed.emplace_back(world.template position<TPosition>(*it), *it);
+    }
+    std::sort(keyed.begin(), keyed.end(), [](auto &&lhs, auto &&rhs) { return lhs.first < rhs.first; });
+    std::transform(keyed.begin(), keyed.end(), first, [](auto &&k) { return k.second; });
+    result.offsets_.push_back(result.ids_.size());
+  }
+
+ private:
+  float cell_size_;
+  std::unordered_map<uint64_t, std::vector<Entry>> cells_;
+  std::vector<Slot> slots_;  // by entity index, where its entry is
+  uint64_t size_ = 0;
+};
+
+}  // namespace xac::ecs
\ No newline at end of file
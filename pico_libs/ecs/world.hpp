@@ -2,15 +2,28 @@
 #include <assert.h>
 
 #include <algorithm>
-#include <forward_list>
+#include <compare>
 #include <functional>
+#include <iterator>
+#include <memory>
 #include <numeric>
 #include <pico_libs/mpl/bitset.hpp>
 #include <pico_libs/mpl/type_list.hpp>
+#include <pico_libs/mpl/type_name.hpp>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <variant>
 #include <vector>
 
 #include "component.hpp"
 #include "entity.hpp"
+#include "group.hpp"
+#include "memory_stats.hpp"
+#include "observer.hpp"
+#include "paged_vector.hpp"
+#include "pool.hpp"
+#include "profiler.hpp"
 #include "settings.hpp"
 namespace xac::ecs {
 template <typename TSettings>
@@ -22,32 +35,68 @@ template <typename TSettings>
 class World {
  public:
   using ComponentList = typename TSettings::ComponentList;
+  template <typename T>
+  using PoolOf = std::conditional_t<
+      is_shared_v<TSettings, T>, SharedPool<T>, std::conditional_t<is_buffered_v<TSettings, T>, BufferedPool<T>, Pool<T>>>;
   template <typename... Args>
-  using TupleOfVectors = std::tuple<std::vector<Args>...>;
+  using TupleOfPools = std::tuple<PoolOf<Args>...>;
   using ThisEntity = Entity<TSettings>;
   template <typename T>
   using ComponentHandle = ComponentHandle<TSettings, T>;
   using EntityId = typename ThisEntity::Id;
+  using ObserverList = typename TSettings::ObserverList;
+  template <typename... Events>
+  using TupleOfObservers = std::tuple<Observer<TSettings, Events>...>;
+  constexpr static bool kProfiling = TSettings::kEnableProfiling;
+  using GroupList = typename TSettings::GroupList;
+  // one bit per component, plus the alive and prefab bits on top, so a view checks liveness and components in one go
+  using ComponentsMask = std::bitset<ComponentList::size + 2>;
+  constexpr static uint64_t kAliveBit = ComponentList::size;
+  constexpr static uint64_t kPrefabBit = ComponentList::size + 1;
+
+  friend class Entity<TSettings>;
 
  private:
   template <typename... Args>
   struct basic_view;
+  // held by reference, so a profiled view is copyable like any other, the scope ends with its last copy
+  using ViewScope = Profiler::ViewScope;
+
+  // e.g. "fuzzy_view<Position, Acc>"
+  template <typename... Args>
+  static auto view_name(std::string_view kind) -> std::string {
+    std::string name{kind};
+    name += '<';
+    ((name += mpl::type_name_v<std::decay_t<Args>>, name += ", "), ...);
+    if constexpr (sizeof...(Args) > 0) {
+      name.resize(name.size() - 2);
+    }
+    return name + '>';
+  }
 
+  // forward iterator over the entities matching Pred, ends at std::default_sentinel
+  // HINT: iterators of all views yield a tuple of component references by value,
+  // their categories are claimed anyway, like std::vector<bool>::iterator
   template <typename Pred, typename... Args>
   class basic_iterator {  // HINT: after c++17, std::iterator is deperated
    public:
     using value_type = typename basic_view<Args...>::value_type;
+    using reference = value_type;
+    using difference_type = int64_t;
+    using iterator_category = std::forward_iterator_tag;
     using type = basic_iterator<Pred, Args...>;
-    basic_iterator(World *world, uint64_t i) : world_(world), i_(i) {
+    basic_iterator() = default;
+    basic_iterator(World *world, uint64_t i, ViewCounters *counters = nullptr)
+        : world_(world), i_(i), counters_(counters) {
       next();
     }
-    auto operator*() -> value_type {
-      return {std::get<mpl::index_of_v<std::decay_t<Args>, ComponentList>>(world_->components_pool_).at(i_)...};
+    auto operator*() const -> value_type {
+      return std::tuple_cat(world_->template fetch<Args>(i_)...);
     }
     auto operator++(int) -> type {
-      auto temp = this;
-      ++(*temp);
-      return *temp;
+      auto temp = *this;
+      ++(*this);
+      return temp;
     }
     auto operator++() -> type & {
       i_++;
@@ -55,74 +104,108 @@ class World {
       return *this;
     }
     friend auto operator==(const type &lhs, const type &rhs) -> bool {
-      assert(lhs.world_ == rhs.world_);
-      return lhs.i_ == rhs.i_;
+      return lhs.world_ == rhs.world_ && lhs.i_ == rhs.i_;
+    }
+    friend auto operator==(const type &it, std::default_sentinel_t) -> bool {
+      return it.at_end();
+    }
+    // id of the entity at current position
+    auto id() const -> EntityId {
+      return {i_, world_->entity_version_[i_]};
     }
 
    private:
+    auto at_end() const -> bool {
+      return i_ >= world_->entity_count_;
+    }
     auto next() -> void {
-      for (; i_ < entity_count_; i_++) {
-        auto entity = world_->entities_.at(i_);
-        if (world_->entities_.at(i_).id_.version != world_->entity_version_.at(i_)) {  // dead entity
-          continue;
-        }
-        static_assert(std::is_same_v<std::invoke_result_t<Pred, ThisEntity>, bool>, "pred is not returning bool value");
-        if (std::invoke(Pred{}, entity)) {
+      [[maybe_unused]] auto start = i_;
+      // HINT: only touch the mask array here, dead entities have no alive bit so never match
+      auto &&masks = world_->components_mask_;
+      auto count = world_->entity_count_;
+      static_assert(
+          std::is_same_v<std::invoke_result_t<Pred, const ComponentsMask &>, bool>, "pred is not returning bool value"
+      );
+      for (; i_ < count; i_++) {
+        if (std::invoke(Pred{}, masks[i_])) {
           break;
         }
       }
+      if constexpr (kProfiling) {
+        if (counters_ != nullptr) {
+          add_count(counters_->scanned, i_ - start + (i_ < count));
+          add_count(counters_->matched, i_ < count);
+        }
+      }
     }
 
    private:
-    World<TSettings> *world_;
-    uint64_t i_;
+    World<TSettings> *world_ = nullptr;
+    uint64_t i_ = 0;
+    ViewCounters *counters_ = nullptr;
   };
 
   template <typename... Args>
   struct basic_view {
-    friend class basic_iterator<Args...>;
-    using value_type = std::tuple<std::remove_reference_t<Args> &...>;
+    // tags are filtered out
+    using value_type =
+        mpl::rename<std::tuple, mpl::filter_t<is_stored, mpl::type_list<component_ref_t<TSettings, Args>...>>>;
 
     template <typename Pred>
-    class view_internal {
+    class view_internal : public std::ranges::view_interface<view_internal<Pred>> {
      public:
-      view_internal(World<TSettings> *world) : world_(world) {}
+      view_internal(World<TSettings> *world) : world_(world) {
+        if constexpr (kProfiling) {
+          profile_ = std::make_shared<ViewScope>(world_->profiler_.view_scope(name()));
+        }
+      }
       auto begin() -> basic_iterator<Pred, Args...> {
+        if constexpr (kProfiling) {
+          add_count(profile_->counters()->iterations, 1);
+          return basic_iterator<Pred, Args...>{world_, 0, profile_->counters()};
+        }
         return basic_iterator<Pred, Args...>{world_, 0};
       }
-      auto end() -> basic_iterator<Pred, Args...> {
-        return basic_iterator<Pred, Args...>(world_, entity_count_);
+      auto end() const -> std::default_sentinel_t {
+        return std::default_sentinel;
+      }
+      static auto name() -> std::string_view {
+        static const std::string name = view_name<Args...>(Pred::kName);
+        return name;
       }
 
      protected:
       World<TSettings> *world_;
+      [[no_unique_address]] std::conditional_t<kProfiling, std::shared_ptr<ViewScope>, std::monostate> profile_;
     };
 
-    // always return all entities
+    // always return all alive entities
     struct DebugPred {
-      auto operator()(const ThisEntity &entity) {
-        return true;
+      constexpr static std::string_view kName = "debug_view";
+      auto operator()(const ComponentsMask &mask) -> bool {
+        return mask.test(kAliveBit);
       }
     };
 
     // return entities whose components list is the subset of the input components list
     struct FuzzyPred {
-      auto operator()(const ThisEntity &entity) {
-        return (mask_ & entity.components_mask_) == mask_;
+      constexpr static std::string_view kName = "fuzzy_view";
+      auto operator()(const ComponentsMask &mask) -> bool {
+        return (mask_ & mask) == mask_;
       }
     };
 
     // only return entities whose components list exactly match the input components list
     struct ExactPred {
-      auto operator()(const ThisEntity &entity) {
-        return mask_ == entity.components_mask_;
+      constexpr static std::string_view kName = "exact_view";
+      auto operator()(const ComponentsMask &mask) -> bool {
+        return mask_ == mask;
       }
     };
 
-    inline constexpr static auto mask_value_ =
-        mpl::index_bits_str_v<ComponentList::size, mpl::index_of_v<std::decay_t<Args>, ComponentList>...>;
-    inline static std::bitset<ComponentList::size> mask_ =
-        std::bitset<ComponentList::size>(mask_value_.data(), ComponentList::size);
+    inline constexpr static auto mask_value_ = mpl::index_bits_str_v<
+        ComponentList::size + 2, kAliveBit, mpl::index_of_v<std::decay_t<Args>, ComponentList>...>;
+    inline static ComponentsMask mask_ = ComponentsMask(mask_value_.data(), ComponentList::size + 2);
 
    public:
     using debug_view = view_internal<DebugPred>;
@@ -130,58 +213,341 @@ class World {
     using exact_view = view_internal<ExactPred>;
   };
 
+  // walk the packed front of the pools owned by group<Args...> in parallel, no mask test needed
+  // a random access and sized range, so it can be split for parallel algorithms
+  template <typename... Args>
+  class basic_group_view : public std::ranges::view_interface<basic_group_view<Args...>> {
+    using Group = group<std::decay_t<Args>...>;
+    static_assert(mpl::contains_v<Group, GroupList>, "group is not in group list");
+    static_assert((!is_tag_v<Args> && ...), "tags can not be grouped");
+
+   public:
+    using value_type = std::tuple<component_ref_t<TSettings, Args>...>;
+
+    class iterator {
+     public:
+      using value_type = basic_group_view::value_type;
+      using reference = value_type;
+      using difference_type = int64_t;
+      using iterator_category = std::random_access_iterator_tag;
+
+      iterator() = default;
+      iterator(World *world, uint64_t pos) : world_(world), pos_(pos) {}
+      auto operator*() const -> value_type {
+        return {world_->template fetch_at<Args>(pos_)...};
+      }
+      auto operator[](difference_type n) const -> value_type {
+        return *(*this + n);
+      }
+      auto operator++() -> iterator & {
+        pos_++;
+        return *this;
+      }
+      auto operator++(int) -> iterator {
+        auto temp = *this;
+        ++(*this);
+        return temp;
+      }
+      auto operator--() -> iterator & {
+        pos_--;
+        return *this;
+      }
+      auto operator--(int) -> iterator {
+        auto temp = *this;
+        --(*this);
+        return temp;
+      }
+      auto operator+=(difference_type n) -> iterator & {
+        pos_ += n;
+        return *this;
+      }
+      auto operator-=(difference_type n) -> iterator & {
+        pos_ -= n;
+        return *this;
+      }
+      friend auto operator+(iterator it, difference_type n) -> iterator {
+        return it += n;
+      }
+      friend auto operator+(difference_type n, iterator it) -> iterator {
+        return it += n;
+      }
+      friend auto operator-(iterator it, difference_type n) -> iterator {
+        return it -= n;
+      }
+      friend auto operator-(const iterator &lhs, const iterator &rhs) -> difference_type {
+        return static_cast<difference_type>(lhs.pos_) - static_cast<difference_type>(rhs.pos_);
+      }
+      friend auto operator==(const iterator &lhs, const iterator &rhs) -> bool {
+        return lhs.world_ == rhs.world_ && lhs.pos_ == rhs.pos_;
+      }
+      friend auto operator<=>(const iterator &lhs, const iterator &rhs) -> std::strong_ordering {
+        assert(lhs.world_ == rhs.world_);
+        return lhs.pos_ <=> rhs.pos_;
+      }
+      // id of the entity at current position
+      auto id() const -> EntityId {
+        auto index = world_->template pool<mpl::type_at_t<0, Group>>().entity_at(pos_);
+        return {index, world_->entity_version_[index]};
+      }
+
+     private:
+      World *world_ = nullptr;
+      uint64_t pos_ = 0;
+    };
+
+    // HINT: call World::detach() on the written types before writing chunks of the view from several threads
+    basic_group_view(World *world) : world_(world) {
+      if constexpr (kProfiling) {
+        profile_ = std::make_shared<ViewScope>(world_->profiler_.view_scope(name()));
+      }
+    }
+    auto begin() -> iterator {
+      if constexpr (kProfiling) {
+        auto counters = profile_->counters();
+        add_count(counters->iterations, 1);
+        add_count(counters->scanned, size());
+        add_count(counters->matched, size());
+      }
+      return {world_, 0};
+    }
+    auto end() const -> iterator {
+      return {world_, size()};
+    }
+    auto size() const -> uint64_t {
+      return world_->group_size_[mpl::index_of_v<Group, GroupList>];
+    }
+    static auto name() -> std::string_view {
+      static const std::string name = view_name<Args...>("group_view");
+      return name;
+    }
+
+   private:
+    World *world_;
+    [[no_unique_address]] std::conditional_t<kProfiling, std::shared_ptr<ViewScope>, std::monostate> profile_;
+  };
+
  public:
   World();
 
   [[nodiscard]] auto create() -> EntityId {
-    EntityId id;
-    if (!free_entities_.empty()) {
-      id.index = free_entities_.front();
-      free_entities_.pop_front();
-      id.version = entity_version_.at(id.index);
-      auto &e = entities_.at(id.index);
-      e.id_ = id;
-      e.components_mask_.reset();
+    return create_entity(kAliveBit);
+  }
 
-      return id;
+  // an entity skipped by views and each(), used as a template by instantiate()
+  [[nodiscard]] auto create_prefab() -> EntityId {
+    return create_entity(kPrefabBit);
+  }
+
+  // create count entities holding copies of the components of prefab, one pool at a time
+  // shared components are referenced rather than copied
+  // throws std::invalid_argument, before creating anything, if the prefab has a move only component
+  auto instantiate(const EntityId &prefab, uint64_t count) -> std::vector<EntityId> {
+    invalidate(prefab);
+    auto &&mask = components_mask_[prefab.index];
+    bool copyable = [&]<typename... Ts>(mpl::type_list<Ts...>) {
+      return ((kCopyable<Ts> || !mask.test(mpl::index_of_v<Ts, ComponentList>)) && ...);
+    }(mpl::rename<mpl::type_list, ComponentList>{});
+    if (!copyable) {
+      throw std::invalid_argument("prefab has a move only component");
     }
-    prepare_entity_create();
-    // should only increment when destroy an entity?
-    auto &e = entities_.at(entity_count_);
-    id.index = entity_count_;
-    id.version = entity_version_.at(entity_count_);
-    e.id_ = id;
-    e.world_ = this;
-    entity_count_++;
-    return id;
+    std::vector<EntityId> ids(count);
+    uint64_t index_end = 0;
+    for (auto &&id : ids) {
+      id = create();
+      index_end = std::max(index_end, id.index + 1);
+    }
+    instantiate_components(prefab, ids, index_end, mpl::rename<mpl::type_list, ComponentList>{});
+    for (auto &&id : ids) {
+      group_add_all(id.index);
+    }
+    return ids;
   }
 
   auto destroy(const EntityId &id) -> void {
     invalidate(id);
-    entity_version_[id.index]++;
-    free_entities_.push_front(id.index);
+    remove_all(id, mpl::rename<mpl::type_list, ComponentList>{});
+    notify<on_destroy>(id);
+    components_mask_.mut(id.index).reset();  // includes the alive bit
+    entity_version_.mut(id.index)++;
+    free_entities_.push_back(id.index);
   }
 
   template <typename T, typename... Args>
   [[nodiscard]] auto assign(EntityId &id, Args &&...args) -> ComponentHandle<T> {
     static_assert(TSettings::template has_component<T>(), "type is not in component list");
     prepare_component_create<T>(id);
-    auto &entity = entities_.at(id.index);
-    entity.id_ = id;
-    entity.components_mask_.set(mpl::index_of_v<T, ComponentList>);
-    auto &pool = std::get<mpl::index_of_v<T, ComponentList>>(components_pool_);
-    pool[id.index] = T{std::forward<Args>(args)...};
+    auto &pool = this->pool<T>();
+    [[maybe_unused]] auto capacity = pool.capacity();
+    pool.emplace(id.index, std::forward<Args>(args)...);
+    // HINT: only after construction, an entity whose T threw is left without T
+    components_mask_.mut(id.index).set(mpl::index_of_v<T, ComponentList>);
+    if constexpr (kProfiling) {
+      if (pool.capacity() != capacity) {
+        profiler_.record_pool_growth(mpl::type_name_v<T>, pool.bytes_reserved());
+      }
+    }
+    group_add<T>(id.index);
+    notify<on_add<T>>(id);
     return {id, this};
   }
 
+  // construct T in place, or replace the existing one
+  template <typename T, typename... Args>
+  auto emplace_or_replace(EntityId &id, Args &&...args) -> ComponentHandle<T> {
+    static_assert(TSettings::template has_component<T>(), "type is not in component list");
+    invalidate(id);
+    if (!components_mask_[id.index].test(mpl::index_of_v<T, ComponentList>)) {
+      return assign<T>(id, std::forward<Args>(args)...);
+    }
+    pool<T>().replace(id.index, std::forward<Args>(args)...);
+    notify<on_update<T>>(id);
+    return {id, this};
+  }
+
+  // modify T in place by f(T &), and raise on_update<T>
+  template <typename T, typename F>
+  auto patch(const EntityId &id, F &&f) -> T & {
+    static_assert(TSettings::template has_component<T>(), "type is not in component list");
+    static_assert(!is_shared_v<TSettings, T>, "shared component is read only, use emplace_or_replace");
+    invalidate(id);
+    assert(components_mask_[id.index].test(mpl::index_of_v<T, ComponentList>) && "does not have this component");
+    auto &value = pool<T>().get(id.index);
+    std::invoke(std::forward<F>(f), value);
+    notify<on_update<T>>(id);
+    return value;
+  }
+
+  template <typename T>
+  auto remove(const EntityId &id) -> void {
+    static_assert(TSettings::template has_component<T>(), "type is not in component list");
+    invalidate(id);
+    assert(components_mask_[id.index].test(mpl::index_of_v<T, ComponentList>) && "does not have this component");
+    remove_component<T>(id.index);
+    components_mask_.mut(id.index).reset(mpl::index_of_v<T, ComponentList>);
+    notify<on_remove<T>>(id);
+  }
+
+  // add Tag to every entity yielded by a view, skip the ones already having it
+  template <typename Tag, typename View>
+  auto set_tag(View &&view) -> void {
+    static_assert(is_tag_v<Tag>, "type is not a tag");
+    static_assert(TSettings::template has_component<Tag>(), "type is not in component list");
+    constexpr uint64_t bit = mpl::index_of_v<Tag, ComponentList>;
+    auto &pool = this->pool<Tag>();
+    for (auto it = view.begin(); it != view.end(); ++it) {
+      auto id = it.id();
+      if (!components_mask_[id.index].test(bit)) {
+        components_mask_.mut(id.index).set(bit);
+        pool.emplace(id.index);
+        notify<on_add<Tag>>(id);
+      }
+    }
+  }
+
+  // remove Tag from every entity yielded by a view, skip the ones not having it
+  template <typename Tag, typename View>
+  auto clear_tag(View &&view) -> void {
+    static_assert(is_tag_v<Tag>, "type is not a tag");
+    static_assert(TSettings::template has_component<Tag>(), "type is not in component list");
+    constexpr uint64_t bit = mpl::index_of_v<Tag, ComponentList>;
+    auto &pool = this->pool<Tag>();
+    for (auto it = view.begin(); it != view.end(); ++it) {
+      auto id = it.id();
+      if (components_mask_[id.index].test(bit)) {
+        components_mask_.mut(id.index).reset(bit);
+        pool.remove(id.index);
+        notify<on_remove<Tag>>(id);
+      }
+    }
+  }
+
+  // reorder the pool of T by compare(const T &, const T &), T must be owned by a group
+  // the other pools of the group follow the same order, so group_view yields entities sorted
+  template <typename T, typename Compare>
+  auto sort(Compare compare) -> void {
+    constexpr uint64_t group_index = group_of<T>();
+    static_assert(group_index != kNoGroup, "type is not owned by any group");
+    using Group = mpl::type_at_t<group_index, GroupList>;
+    auto size = group_size_[group_index];
+    auto order = pool<T>().sort(0, size, std::move(compare));
+    [&]<typename... Ts>(group<Ts...>) {
+      (
+          [&] {
+            if constexpr (!std::is_same_v<Ts, T>) {
+              pool<Ts>().arrange(0, order);
+            }
+          }(),
+          ...
+      );
+    }(Group{});
+  }
+
+  // register a callback for an event listed in TSettings::ObserverList
+  template <typename TEvent>
+  auto observe(typename Observer<TSettings, TEvent>::Callback callback) -> void {
+    static_assert(mpl::contains_v<TEvent, ObserverList>, "event is not in observer list");
+    std::get<mpl::index_of_v<TEvent, ObserverList>>(observers_).connect(std::move(callback));
+  }
+
+  // dispatch all events recorded since last flush, in the order of TSettings::ObserverList
+  // events raised by the callbacks go to the next flush, whichever observer they belong to
+  auto flush() -> void {
+    std::apply([](auto &&...observer) { (observer.prepare(), ...); }, observers_);
+    std::apply([this](auto &&...observer) { (observer.dispatch(*this), ...); }, observers_);
+  }
+
+  // flip the buffers of every type in TSettings::BufferedList, O(number of buffered types)
+  // values written this tick become the ones read by const views in the next tick, the others are still read
+  auto swap_buffers() -> void {
+    [this]<typename... Ts>(mpl::type_list<Ts...>) {
+      static_assert((!is_shared_v<TSettings, Ts> && ...), "shared component can not be double buffered");
+      (pool<Ts>().swap(), ...);
+    }(mpl::rename<mpl::type_list, typename TSettings::BufferedList>{});
+  }
+
+  // only available when TSettings::kEnableProfiling is set
+  auto profiler() -> Profiler & {
+    static_assert(kProfiling, "profiling is not enabled in settings");
+    return profiler_;
+  }
+
+  // O(number of component types), cheap enough to poll periodically
+  auto memory_stats() const -> MemoryStats<ComponentList::size> {
+    MemoryStats<ComponentList::size> stats;
+    auto &&entities = stats.entities;
+    entities.name = "entities";
+    auto free_count = free_entities_.size();
+    entities.capacity = components_mask_.capacity();
+    entities.size = entity_count_ - free_count;
+    entities.bytes_reserved =
+        components_mask_.bytes_reserved() + entity_version_.bytes_reserved() + free_entities_.bytes_reserved();
+    entities.bytes_used = entities.size * (sizeof(ComponentsMask) + sizeof(uint64_t));  // mask and version
+    entities.fragmentation = entity_count_ == 0 ? 0 : static_cast<double>(free_count) / entity_count_;
+    [&]<uint64_t... I>(std::integer_sequence<uint64_t, I...>) {
+      ((stats.components[I] = pool_stats<I>()), ...);
+    }(std::make_integer_sequence<uint64_t, ComponentList::size>{});
+    return stats;
+  }
+
+  auto valid(const EntityId &id) const -> bool {
+    return id.index < entity_count_ && id.version == entity_version_[id.index] &&
+           (components_mask_[id.index].test(kAliveBit) || components_mask_[id.index].test(kPrefabBit));
+  }
+
+  // valid and not a prefab, so yielded by views
+  auto alive(const EntityId &id) const -> bool {
+    return id.index < entity_count_ && id.version == entity_version_[id.index] &&
+           components_mask_[id.index].test(kAliveBit);
+  }
+
   template <typename F>
   auto each(F &&f) {
     for (uint64_t i = 0; i < entity_count_; i++) {
-      if (entity_version_[i] != entities_[i].id_.version) {
+      if (!components_mask_[i].test(kAliveBit)) {
         continue;
       }
       if constexpr (std::is_invocable_v<F, ThisEntity, uint64_t>) {
-        std::invoke(f, entities_[i], i);
+        std::invoke(f, ThisEntity{{i, entity_version_[i]}, this}, i);
       } else {
         assert(false);
       }
@@ -203,15 +569,30 @@ class World {
     return typename basic_view<Args...>::debug_view{this};
   }
 
+  // group<std::decay_t<Args>...> must be in TSettings::GroupList
+  template <typename... Args>
+  auto group_view() -> basic_group_view<Args...> {
+    return basic_group_view<Args...>{this};
+  }
+
+  // position of the entity in the pool of T, or the largest value if it has no T
+  // entities walked in this order read the pool forward, until it is next reordered
   template <typename T>
-  auto has(const EntityId &id) -> bool {
+  auto position(const EntityId &id) const -> uint64_t {
+    static_assert(!is_tag_v<T>, "tags are not stored in a pool");
+    auto &&pool = std::get<mpl::index_of_v<T, ComponentList>>(components_pool_);
+    return pool.contains(id.index) ? pool.position(id.index) : std::numeric_limits<uint64_t>::max();
+  }
+
+  template <typename T>
+  auto has(const EntityId &id) const -> bool {
     invalidate(id);
-    return entities_.at(id.index).components_mask_.test(mpl::index_of_v<T, ComponentList>);
+    return components_mask_[id.index].test(mpl::index_of_v<T, ComponentList>);
   }
 
-  auto get(const EntityId &id) -> ThisEntity & {
+  auto get(const EntityId &id) -> ThisEntity {
     invalidate(id);
-    return entities_.at(id.index);
+    return {id, this};
   }
 
   template <typename T>
@@ -220,63 +601,323 @@ class World {
     return {id, this};
   }
 
+  // stable while the pool grows, but not across fork() or restore(), see fork()
   template <typename T>
-  auto get_ptr(const EntityId &id) -> T * {
+  auto get_ptr(const EntityId &id) -> std::remove_reference_t<component_ref_t<TSettings, T>> * {
     static_assert(TSettings::template has_component<T>(), "type is not in component list");
     invalidate(id);
     constexpr uint64_t index = mpl::index_of_v<T, ComponentList>;
-    if (entities_.at(id.index).components_mask_.test(index)) {
-      return &std::get<index>(components_pool_).at(id.index);
+    if (components_mask_[id.index].test(index)) {
+      return &std::get<index>(components_pool_).get(id.index);
     }
     return nullptr;
   }
 
+  // read only access, never copies a page shared with a fork
+  // so on a forked world it is invalid after the next mutable access to the pool, see fork()
+  template <typename T>
+  auto get_ptr(const EntityId &id) const -> const T * {
+    static_assert(TSettings::template has_component<T>(), "type is not in component list");
+    invalidate(id);
+    constexpr uint64_t index = mpl::index_of_v<T, ComponentList>;
+    if (components_mask_[id.index].test(index)) {
+      return &std::get<index>(components_pool_).cget(id.index);
+    }
+    return nullptr;
+  }
+
+  // the reference held by the entity, assign it to other entities to share the value
+  template <typename T>
+  auto get_shared(const EntityId &id) const -> std::shared_ptr<const T> {
+    static_assert(is_shared_v<TSettings, T>, "type is not in shared list");
+    invalidate(id);
+    if (components_mask_[id.index].test(mpl::index_of_v<T, ComponentList>)) {
+      return std::get<mpl::index_of_v<T, ComponentList>>(components_pool_).handle(id.index);
+    }
+    return nullptr;
+  }
+
+  // a world sharing all storage pages with this one, O(number of pages)
+  // pages are copied on first write from either side, so the fork can be mutated freely and thrown away
+  // observers and profiler are not forked
+  // every component must be copyable or shared, a move only one fails to compile, naming it in forkable<T>
+  // HINT: pointers and references to components taken before, and const ones taken from either world, are invalid
+  // after the next mutable access to their pool, writes through them may land in the other world
+  [[nodiscard]] auto fork() -> World {
+    World fork{kNoInit};
+    fork.share_from(*this);
+    return fork;
+  }
+
+  // copy the pages of the pools of Ts which are still shared with a fork, O(number of pages)
+  // call it before writing Ts from several threads, e.g. chunks of a group view, otherwise the first write to a
+  // shared page, or to a page of a double buffered type in a new tick, replaces it from whichever thread gets there
+  template <typename... Ts>
+  auto detach() -> void {
+    (pool<Ts>().detach(), ...);
+  }
+
+  // roll this world back to the state of a fork or a snapshot taken by fork(), O(number of pages)
+  // observers are kept but no event is raised, pending events are dropped
+  // same requirement on the components as fork(), pointers and references taken before are invalid
+  auto restore(World &snapshot) -> void {
+    share_from(snapshot);
+    std::apply([](auto &&...observer) { (observer.clear(), ...); }, observers_);
+  }
+
  private:
-  auto invalidate(const EntityId &id) -> void {
+  auto invalidate(const EntityId &id) const -> void {
     assert(id.index < entity_count_ && "id exceed entity count");
-    assert(id.version == entity_version_.at(id.index) && "id out of date");
-    assert(id.version == entities_.at(id.index).id_.version && "id out of date");
+    assert(id.version == entity_version_[id.index] && "id out of date");
+    assert(
+        (components_mask_[id.index].test(kAliveBit) || components_mask_[id.index].test(kPrefabBit)) &&
+        "entity is destroyed"
+    );
+  }
+  auto create_entity(uint64_t kind_bit) -> EntityId {
+    EntityId id;
+    if (!free_entities_.empty()) {
+      id.index = free_entities_.back();
+      free_entities_.pop_back();
+      id.version = entity_version_[id.index];
+      components_mask_.mut(id.index).set(kind_bit);
+      return id;
+    }
+    prepare_entity_create();
+    // should only increment when destroy an entity?
+    id.index = entity_count_;
+    id.version = entity_version_[entity_count_];
+    components_mask_.mut(id.index).set(kind_bit);
+    entity_count_++;
+    return id;
+  }
+  template <typename... Ts>
+  auto instantiate_components(
+      const EntityId &prefab, std::span<const EntityId> ids, uint64_t index_end, mpl::type_list<Ts...>
+  ) -> void {
+    auto mask = components_mask_[prefab.index];
+    (
+        [&] {
+          constexpr uint64_t bit = mpl::index_of_v<Ts, ComponentList>;
+          if (!mask.test(bit)) {
+            return;
+          }
+          if constexpr (kCopyable<Ts>) {  // prefabs with move only ones are rejected upfront
+            auto &pool = this->pool<Ts>();
+            [[maybe_unused]] auto capacity = pool.capacity();
+            pool.reserve(pool.size() + ids.size(), index_end);
+            for (auto &&id : ids) {
+              pool.clone(prefab.index, id.index);
+              components_mask_.mut(id.index).set(bit);
+              notify<on_add<Ts>>(id);
+            }
+            if constexpr (kProfiling) {
+              if (pool.capacity() != capacity) {
+                profiler_.record_pool_growth(mpl::type_name_v<Ts>, pool.bytes_reserved());
+              }
+            }
+          }
+        }(),
+        ...
+    );
+  }
+  // what an instance copies from its prefab, the reference of a shared component rather than the value
+  template <typename T>
+  constexpr static bool kCopyable = is_shared_v<TSettings, T> || std::is_copy_constructible_v<T>;
+  struct NoInit {};
+  constexpr static NoInit kNoInit{};
+  World(NoInit) {}
+  // pages shared with a fork are copied on write, so T must be copyable or held by reference
+  template <typename T>
+  constexpr static auto forkable() -> bool {
+    static_assert(kCopyable<T>, "move only component can not be forked, T is the type of this forkable<T>");
+    return kCopyable<T>;
+  }
+  auto share_from(World &other) -> void {
+    constexpr bool all_forkable = []<typename... Ts>(mpl::type_list<Ts...>) {
+      return (forkable<Ts>() && ...);
+    }(mpl::rename<mpl::type_list, ComponentList>{});
+    if constexpr (all_forkable) {  // HINT: otherwise only the assertions above are reported
+      [&]<uint64_t... I>(std::integer_sequence<uint64_t, I...>) {
+        ((std::get<I>(components_pool_) = std::get<I>(other.components_pool_).share()), ...);
+      }(std::make_integer_sequence<uint64_t, ComponentList::size>{});
+      group_size_ = other.group_size_;
+      components_mask_ = other.components_mask_.share();
+      entity_version_ = other.entity_version_.share();
+      entity_count_ = other.entity_count_;
+      free_entities_ = other.free_entities_.share();
+    }
   }
   auto prepare_entity_create() -> void;
   template <typename T>
   auto prepare_component_create(const EntityId &id) -> void;
   // generate view mask in compile time
 
+  template <typename T>
+  auto pool() -> PoolOf<T> & {
+    return std::get<mpl::index_of_v<T, ComponentList>>(components_pool_);
+  }
+  // one element tuple of the component reference, or an empty tuple for a tag
+  // const ones are read without copying pages shared with a fork
+  template <typename Arg>
+  auto fetch(uint64_t index) {
+    using Ref = component_ref_t<TSettings, Arg>;
+    if constexpr (is_tag_v<Arg>) {
+      return std::tuple<>{};
+    } else if constexpr (std::is_const_v<std::remove_reference_t<Ref>>) {
+      return std::tuple<Ref>{pool<std::decay_t<Arg>>().cget(index)};
+    } else {
+      return std::tuple<Ref>{pool<std::decay_t<Arg>>().get(index)};
+    }
+  }
+  template <typename Arg>
+  auto fetch_at(uint64_t pos) -> component_ref_t<TSettings, Arg> {
+    if constexpr (std::is_const_v<std::remove_reference_t<component_ref_t<TSettings, Arg>>>) {
+      return pool<std::decay_t<Arg>>().cat(pos);
+    } else {
+      return pool<std::decay_t<Arg>>().at(pos);
+    }
+  }
+
+  template <uint64_t I>
+  auto pool_stats() const -> PoolStats {
+    using T = mpl::type_at_t<I, ComponentList>;
+    auto &&pool = std::get<I>(components_pool_);
+    PoolStats stats;
+    stats.name = mpl::type_name_v<T>;
+    stats.capacity = pool.capacity();
+    stats.size = pool.size();
+    stats.bytes_reserved = pool.bytes_reserved();
+    stats.bytes_used = pool.bytes_used();
+    auto addressable = std::min<uint64_t>(entity_count_, pool.sparse_size());
+    stats.fragmentation = addressable == 0 ? 0 : 1 - static_cast<double>(stats.size) / addressable;
+    return stats;
+  }
+
+  // compiled out when the event is not in TSettings::ObserverList
+  template <typename TEvent>
+  auto notify(const EntityId &id) -> void {
+    if constexpr (mpl::contains_v<TEvent, ObserverList>) {
+      std::get<mpl::index_of_v<TEvent, ObserverList>>(observers_).record(id);
+    }
+  }
+  template <typename... Ts>
+  auto remove_all(const EntityId &id, mpl::type_list<Ts...>) -> void {
+    auto &mask = components_mask_[id.index];  // HINT: the mask is not written until all are removed
+    (
+        [&] {
+          if (mask.test(mpl::index_of_v<Ts, ComponentList>)) {
+            remove_component<Ts>(id.index);
+            notify<on_remove<Ts>>(id);
+          }
+        }(),
+        ...
+    );
+  }
+  template <typename T>
+  auto remove_component(uint64_t index) -> void {
+    group_remove<T>(index);
+    pool<T>().remove(index);
+  }
+
+  constexpr static uint64_t kNoGroup = std::numeric_limits<uint64_t>::max();
+  // index of the group owning T in GroupList, or kNoGroup
+  template <typename T>
+  constexpr static auto group_of() -> uint64_t {
+    using Groups = mpl::rename<mpl::type_list, GroupList>;
+    constexpr uint64_t owners = []<typename... Gs>(mpl::type_list<Gs...>) {
+      return (uint64_t{mpl::contains_v<T, Gs>} + ... + 0);
+    }(Groups{});
+    static_assert(owners <= 1, "type is owned by more than one group");
+    return []<typename... Gs>(mpl::type_list<Gs...>) {
+      uint64_t owner = kNoGroup;
+      uint64_t i = 0;
+      ((owner = mpl::contains_v<T, Gs> ? i : owner, i++), ...);
+      return owner;
+    }(Groups{});
+  }
+  // entity index just got T, move it into the packed front of the group if it now has all the owned types
+  template <typename T>
+  auto group_add(uint64_t index) -> void {
+    constexpr uint64_t group_index = group_of<T>();
+    if constexpr (group_index != kNoGroup) {
+      group_pack(index, mpl::type_at_t<group_index, GroupList>{});
+    }
+  }
+  // for entities which got several components at once
+  auto group_add_all(uint64_t index) -> void {
+    [&]<typename... Gs>(mpl::type_list<Gs...>) {
+      (group_pack(index, Gs{}), ...);
+    }(mpl::rename<mpl::type_list, GroupList>{});
+  }
+  // move the entity into the packed front of the group if it has all the owned types and is not there yet
+  // prefabs are never packed, so group views skip them like the other views
+  template <typename... Ts>
+  auto group_pack(uint64_t index, group<Ts...>) -> void {
+    static_assert((!is_tag_v<Ts> && ...), "tags can not be grouped");
+    using First = mpl::type_at_t<0, group<Ts...>>;
+    auto &size = group_size_[mpl::index_of_v<group<Ts...>, GroupList>];
+    auto &&mask = components_mask_[index];
+    if (mask.test(kAliveBit) && (mask.test(mpl::index_of_v<Ts, ComponentList>) && ...) &&
+        pool<First>().position(index) >= size) {
+      (pool<Ts>().swap_positions(pool<Ts>().position(index), size), ...);
+      size++;
+    }
+  }
+  // entity index is going to lose T, move it out of the packed front of the group
+  template <typename T>
+  auto group_remove(uint64_t index) -> void {
+    constexpr uint64_t group_index = group_of<T>();
+    if constexpr (group_index != kNoGroup) {
+      [&]<typename... Ts>(group<Ts...>) {
+        auto &size = group_size_[group_index];
+        if (pool<T>().position(index) < size) {
+          size--;
+          (pool<Ts>().swap_positions(pool<Ts>().position(index), size), ...);
+        }
+      }(mpl::type_at_t<group_index, GroupList>{});
+    }
+  }
+
  private:
-  mpl::rename<TupleOfVectors, ComponentList> components_pool_;
-  std::vector<ThisEntity> entities_;
-  std::vector<uint64_t> entity_version_;
-  std::forward_list<uint64_t> free_entities_;
-  inline static uint64_t entity_count_ = 0;
+  mpl::rename<TupleOfPools, ComponentList> components_pool_;
+  std::array<uint64_t, GroupList::size> group_size_{};
+  // entity tables, hot mask array scanned by views and cold version array checked by ids
+  PagedVector<ComponentsMask> components_mask_;
+  PagedVector<uint64_t> entity_version_;
+  uint64_t entity_count_ = 0;
+  PagedVector<uint64_t> free_entities_;  // used as a stack
+  mpl::rename<TupleOfObservers, ObserverList> observers_;
+  [[no_unique_address]] std::conditional_t<kProfiling, Profiler, std::monostate> profiler_;
 };
 
 template <typename TSettings>
 World<TSettings>::World() {
-  entities_.resize(kInitSize);
+  components_mask_.resize(kInitSize);
   entity_version_.resize(kInitSize);
+  if constexpr (kProfiling) {
+    profiler_.record_pool_growth("entities", components_mask_.bytes_reserved() + entity_version_.bytes_reserved());
+  }
 }
 
 template <typename TSettings>
 template <typename T>
 auto World<TSettings>::prepare_component_create(const EntityId &id) -> void {
-  auto entity = entities_[id.index];
   invalidate(id);
-  assert(!entity.components_mask_.test(mpl::index_of_v<T, ComponentList>) && "already has this component");
-  auto &pool = std::get<mpl::index_of_v<T, ComponentList>>(components_pool_);
-  if (entity_count_ >= pool.size()) {
-    // FIX: may out of bound
-    pool.resize(entity_count_ * 2);
-  }
+  assert(!components_mask_[id.index].test(mpl::index_of_v<T, ComponentList>) && "already has this component");
 }
 
 template <typename TSettings>
 auto World<TSettings>::prepare_entity_create() -> void {
-  assert(entities_.size() == entity_version_.size());
-  if (entity_count_ >= entities_.size()) {
+  assert(components_mask_.size() == entity_version_.size());
+  if (entity_count_ >= components_mask_.size()) {
     // FIX: may out of bound
     assert(entity_count_ * 2 <= std::numeric_limits<uint64_t>::max());
-    entities_.resize(entity_count_ * 2, {});  // HINT: must be resize, because you will use index
+    components_mask_.resize(entity_count_ * 2);  // HINT: must be resize, because you will use index
     entity_version_.resize(entity_count_ * 2);
+    if constexpr (kProfiling) {
+      profiler_.record_pool_growth("entities", components_mask_.bytes_reserved() + entity_version_.bytes_reserved());
+    }
   }
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <type_traits>
 #include <utility>
 
 namespace xac::mpl {
@@ -63,5 +64,28 @@ struct contains<T, TList<Head, Rest...>> : contains<T, TList<Rest...>> {};
 template <typename T, typename TList>
 inline constexpr bool contains_v = contains<T, TList>::value;
 
+template <typename... TLists>
+struct concat;
+
+template <template <typename...> class TList, typename... Args>
+struct concat<TList<Args...>> : std::common_type<TList<Args...>> {};
+
+template <template <typename...> class TList, typename... Lhs, typename... Rhs, typename... Rest>
+struct concat<TList<Lhs...>, TList<Rhs...>, Rest...> : concat<TList<Lhs..., Rhs...>, Rest...> {};
+
+template <typename... TLists>
+using concat_t = typename concat<TLists...>::type;
+
+// keep the types which Pred<T>::value is true, in order
+template <template <typename> class Pred, typename TList>
+struct filter;
+
+template <template <typename> class Pred, template <typename...> class TList, typename... Args>
+struct filter<Pred, TList<Args...>>
+    : concat<TList<>, std::conditional_t<Pred<Args>::value, TList<Args>, TList<>>...> {};
+
+template <template <typename> class Pred, typename TList>
+using filter_t = typename filter<Pred, TList>::type;
+
 
 }  // namespace xac::mpl
\ No newline at end of file
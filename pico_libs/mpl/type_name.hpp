@@ -0,0 +1,34 @@
+#pragma once
+#include <string_view>
+
+namespace xac::mpl {
+
+// readable name of T, parsed from the compiler generated function signature
+template <typename T>
+constexpr auto type_name() -> std::string_view {
+#if defined(_MSC_VER) && !defined(__clang__)
+  std::string_view name = __FUNCSIG__;  // "... type_name<struct Foo>(void)"
+  auto begin = name.find("type_name<") + 10;
+  auto end = name.rfind(">(void)");
+  name = name.substr(begin, end - begin);
+  for (std::string_view prefix : {"struct ", "class ", "enum "}) {
+    if (name.starts_with(prefix)) {
+      name.remove_prefix(prefix.size());
+    }
+  }
+  return name;
+#else
+  std::string_view name = __PRETTY_FUNCTION__;  // "... type_name() [with T = Foo; ...]" or "... type_name() [T = Foo]"
+  auto begin = name.find("T = ") + 4;
+  auto end = name.find(';', begin);
+  if (end == std::string_view::npos) {
+    end = name.rfind(']');
+  }
+  return name.substr(begin, end - begin);
+#endif
+}
+
+template <typename T>
+inline constexpr std::string_view type_name_v = type_name<T>();
+
+}  // namespace xac::mpl
\ No newline at end of file
@@ -1,6 +1,13 @@
+#include <algorithm>
 #include <iostream>
+#include <pico_libs/ecs/spatial_grid.hpp>
 #include <pico_libs/ecs/world.hpp>
 #include <random>
+#include <ranges>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <thread>
 
 #include "gtest/gtest.h"
 using namespace xac;
@@ -101,6 +108,34 @@ TEST(ECS_TEST, ENRIRY_RECREATE) {
   ASSERT_EQ(world.get(e).GetComponentsMask().to_string(), "00");
 }
 
+TEST(ECS_TEST, ENTITY_TABLES) {
+  struct CurSettings : ecs::Settings<mpl::type_list<Position, Acc>> {};
+  ecs::World<CurSettings> world_a;
+  ecs::World<CurSettings> world_b;
+  // entity tables belong to each world
+  auto a0 = world_a.create();
+  auto a1 = world_a.create();
+  auto b0 = world_b.create();
+  ASSERT_EQ(a1.index, 1);
+  ASSERT_EQ(b0.index, 0);
+  auto _ = world_a.assign<Position>(a0, 1, 2, 3);
+  ASSERT_EQ(world_a.get(a0).GetComponentsMask().to_string(), "01");
+  ASSERT_EQ(world_a.get(a0).GetWorld(), &world_a);
+
+  world_a.destroy(a0);
+  ASSERT_FALSE(world_a.valid(a0));
+  ASSERT_TRUE(world_a.valid(a1));
+  uint32_t count = 0;
+  for ([[maybe_unused]] auto &&_ : world_a.debug_view<>()) {
+    count++;
+  }
+  ASSERT_EQ(count, 1);
+  for ([[maybe_unused]] auto &&_ : world_a.fuzzy_view<Position>()) {
+    count++;
+  }
+  ASSERT_EQ(count, 1);
+}
+
 TEST(ECS_TEST, COMPONENT_ASSIGN1) {
   using CListD = mpl::type_list<Position, int>;
   using SettingsD = ecs::Settings<CListD>;
@@ -407,4 +442,964 @@ TEST(ECS_TEST, COMPONENT_FUZZY_VIEW) {
   }
 }
 
+TEST(ECS_TEST, OBSERVER) {
+  struct CurSettings : ecs::Settings<mpl::type_list<Position, Acc, Rotation>> {
+    using ObserverList = mpl::type_list<ecs::on_add<Position>, ecs::on_remove<Position>, ecs::on_destroy>;
+  };
+  using EntityId = ecs::Entity<CurSettings>::Id;
+  ecs::World<CurSettings> world;
+
+  std::vector<uint64_t> added, removed, destroyed;
+  uint32_t add_batches = 0;
+  uint32_t stale = 0;
+  world.observe<ecs::on_add<Position>>([&](auto &&w, std::span<const EntityId> ids) {
+    add_batches++;
+    for (auto &&id : ids) {
+      if (!w.valid(id)) {
+        stale++;
+        continue;
+      }
+      added.push_back(id.index);
+    }
+  });
+  world.observe<ecs::on_remove<Position>>([&](auto &&, std::span<const EntityId> ids) {
+    for (auto &&id : ids) {
+      removed.push_back(id.index);
+    }
+  });
+  world.observe<ecs::on_destroy>([&](auto &&w, std::span<const EntityId> ids) {
+    for (auto &&id : ids) {
+      ASSERT_FALSE(w.valid(id));
+      destroyed.push_back(id.index);
+    }
+  });
+
+  std::vector<EntityId> entities;
+  for (uint32_t i = 0; i < 10; i++) {
+    auto e = world.create();
+    auto _ = world.assign<Position>(e, 1, 2, 3);
+    auto __ = world.assign<Acc>(e, 1, 2, 3);  // not observed
+    entities.push_back(e);
+  }
+  // batched, nothing is called before flush
+  ASSERT_TRUE(added.empty());
+  world.flush();
+  ASSERT_EQ(add_batches, 1);
+  ASSERT_EQ(added.size(), 10);
+  world.flush();
+  ASSERT_EQ(add_batches, 1);
+
+  world.remove<Position>(entities[0]);
+  ASSERT_FALSE(world.has<Position>(entities[0]));
+  world.remove<Acc>(entities[1]);
+  world.destroy(entities[2]);  // removes its position as well
+  world.destroy(entities[0]);  // position already removed
+  world.flush();
+  ASSERT_EQ(removed, (std::vector<uint64_t>{0, 2}));
+  ASSERT_EQ(destroyed, (std::vector<uint64_t>{2, 0}));
+
+  // ids may be stale when flushed
+  auto e = world.create();
+  auto _ = world.assign<Position>(e, 1, 2, 3);
+  world.destroy(e);
+  world.flush();
+  ASSERT_EQ(stale, 1);
+  ASSERT_EQ(destroyed.back(), e.index);
+
+  // events raised by callbacks go to the next flush, also for observers after on_add in the list
+  world.observe<ecs::on_add<Position>>([&](auto &&w, std::span<const EntityId> ids) {
+    for (auto &&id : ids) {
+      if (w.valid(id) && w.template get_ptr<Position>(id)->x == -1) {
+        w.destroy(id);
+      }
+    }
+  });
+  destroyed.clear();
+  auto doomed = world.create();
+  auto __ = world.assign<Position>(doomed, -1, 0, 0);
+  world.flush();
+  ASSERT_FALSE(world.valid(doomed));
+  ASSERT_TRUE(destroyed.empty());
+  world.flush();
+  ASSERT_EQ(destroyed, (std::vector<uint64_t>{doomed.index}));
+}
+
+struct ProfilerSettings : ecs::Settings<mpl::type_list<Position, Acc, Rotation>> {
+  constexpr static bool kEnableProfiling = true;
+};
+
+TEST(ECS_TEST, PROFILER) {
+  ecs::World<ProfilerSettings> world;
+  uint32_t entity_count = 1000;
+  for (uint32_t i = 0; i < entity_count; i++) {
+    auto e = world.create();
+    auto _ = world.assign<Position>(e, 1, 2, 3);
+    if (i % 4 == 0) {
+      auto __ = world.assign<Acc>(e, 1, 2, 3);
+    }
+  }
+  {
+    auto scope = world.profiler().scope("system");
+    for (auto &&[p, a] : world.fuzzy_view<Position, Acc>()) {
+      p.x += a.x;
+    }
+  }
+  auto &&counters = world.profiler().counters();
+  auto &&view = counters.views.at("fuzzy_view<Position, Acc>");
+  ASSERT_EQ(view.iterations, 1);
+  ASSERT_EQ(view.scanned, entity_count);
+  ASSERT_EQ(view.matched, entity_count / 4);
+  ASSERT_EQ(counters.scopes.at("system").calls, 1);
+  ASSERT_EQ(counters.pools.at("Position").reallocations, 1);  // one page holds all of them
+  ASSERT_GE(counters.pools.at("Position").bytes_allocated, entity_count * sizeof(Position));
+  ASSERT_TRUE(counters.pools.contains("entities"));
+
+  std::stringstream trace;
+  world.profiler().write_chrome_trace(trace);
+  ASSERT_NE(trace.str().find("\"name\":\"fuzzy_view<Position, Acc>\",\"cat\":\"view\",\"ph\":\"X\""), std::string::npos);
+  ASSERT_NE(trace.str().find("\"scanned\":1000,\"matched\":250"), std::string::npos);
+  {
+    auto scope = world.profiler().scope("ai \"think\"\\\n");
+  }
+  trace.str("");
+  world.profiler().write_chrome_trace(trace);
+  ASSERT_NE(trace.str().find("\"name\":\"ai \\\"think\\\"\\\\\\u000a\""), std::string::npos);
+  world.profiler().clear();
+  ASSERT_TRUE(world.profiler().counters().views.empty());
+}
+
+TEST(ECS_TEST, PROFILER_THREADS) {
+  ecs::World<ProfilerSettings> world;
+  for (uint32_t i = 0; i < 1000; i++) {
+    auto e = world.create();
+    auto _ = world.assign<Position>(e, 1, 2, 3);
+    auto __ = world.assign<Acc>(e, 1, 2, 3);
+  }
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 50; i++) {
+        auto scope = world.profiler().scope(t % 2 == 0 ? "even" : "odd");
+        for (auto &&[p] : world.fuzzy_view<const Position>()) {
+          ASSERT_EQ(p.x, 1);
+        }
+      }
+    });
+  }
+  for (auto &&thread : threads) {
+    thread.join();
+  }
+  auto &&counters = world.profiler().counters();
+  auto &&view = counters.views.at("fuzzy_view<Position>");
+  ASSERT_EQ(view.iterations, 200);
+  ASSERT_EQ(view.matched, 200 * 1000);
+  ASSERT_EQ(counters.scopes.at("even").calls, 100);
+  ASSERT_EQ(counters.scopes.at("odd").calls, 100);
+
+  // each event counts only its own view, and is on the timeline of its thread
+  std::stringstream trace;
+  world.profiler().write_chrome_trace(trace);
+  auto events = trace.str();
+  std::regex view_event(R"("cat":"view","ph":"X","pid":0,"tid":(\d+),[^\n]*"scanned":(\d+),"matched":(\d+))");
+  uint64_t count = 0, scanned = 0, matched = 0;
+  std::set<uint64_t> tids;
+  for (auto it = std::sregex_iterator(events.begin(), events.end(), view_event); it != std::sregex_iterator(); ++it) {
+    count++;
+    tids.insert(std::stoull((*it)[1]));
+    scanned += std::stoull((*it)[2]);
+    matched += std::stoull((*it)[3]);
+  }
+  ASSERT_EQ(count, 200);
+  ASSERT_EQ(scanned, view.scanned);
+  ASSERT_EQ(matched, view.matched);
+  ASSERT_EQ(tids.size(), 4);
+}
+
+TEST(ECS_TEST, MEMORY_STATS) {
+  struct CurSettings : ecs::Settings<mpl::type_list<Position, Acc, Rotation>> {};
+  using EntityId = ecs::Entity<CurSettings>::Id;
+  ecs::World<CurSettings> world;
+  {
+    auto stats = world.memory_stats();
+    ASSERT_EQ(stats.entities.size, 0);
+    ASSERT_GE(stats.entities.capacity, ecs::kInitSize);
+    ASSERT_EQ(stats.components[0].name, "Position");
+    ASSERT_EQ(stats.components[0].capacity, 0);
+  }
+  std::vector<EntityId> entities;
+  for (uint32_t i = 0; i < 100; i++) {
+    auto e = world.create();
+    auto _ = world.assign<Position>(e, 1, 2, 3);
+    if (i % 2 == 0) {
+      auto __ = world.assign<Acc>(e, 1, 2, 3);
+    }
+    entities.push_back(e);
+  }
+  for (uint32_t i = 0; i < 10; i++) {
+    world.destroy(entities[i]);
+  }
+  world.remove<Position>(entities[11]);
+  auto stats = world.memory_stats();
+  ASSERT_EQ(stats.entities.size, 90);
+  ASSERT_DOUBLE_EQ(stats.entities.fragmentation, 0.1);
+  auto &&position = stats.components[mpl::index_of_v<Position, CurSettings::ComponentList>];
+  ASSERT_EQ(position.size, 89);
+  ASSERT_GE(position.capacity, 100);
+  ASSERT_EQ(position.bytes_used, 89 * (sizeof(Position) + 2 * sizeof(uint64_t)));
+  ASSERT_GE(position.bytes_reserved, position.capacity * sizeof(Position));
+  ASSERT_DOUBLE_EQ(position.fragmentation, 0.11);
+  ASSERT_EQ(stats.components[1].size, 45);  // Acc
+  ASSERT_EQ(stats.components[2].size, 0);   // Rotation
+  ASSERT_GT(stats.bytes_reserved(), stats.bytes_used());
+}
+
+TEST(ECS_TEST, GROUP_VIEW) {
+  struct CurSettings : ecs::Settings<mpl::type_list<Position, Acc, Rotation>> {
+    using GroupList = mpl::type_list<ecs::group<Position, Acc>>;
+  };
+  using EntityId = ecs::Entity<CurSettings>::Id;
+  ecs::World<CurSettings> world;
+
+  std::uniform_int_distribution<int> rand_int(-1000, 1000);
+  std::vector<EntityId> entities;
+  for (uint32_t i = 0; i < 1000; i++) {
+    auto e = world.create();
+    int key = rand_int(seed);
+    // assign in both orders, the entity joins the group on the last one
+    if (i % 2 == 0) {
+      auto _ = world.assign<Position>(e, key, 0, 0);
+    }
+    if (i % 3 != 0) {
+      auto _ = world.assign<Acc>(e, key, 0, 0);
+    }
+    if (i % 2 == 1) {
+      auto _ = world.assign<Position>(e, key, 0, 0);
+    }
+    entities.push_back(e);
+  }
+  for (uint32_t i = 0; i < 1000; i += 5) {
+    if (i % 10 == 0) {
+      world.destroy(entities[i]);
+    } else if (world.has<Acc>(entities[i])) {
+      world.remove<Acc>(entities[i]);
+    }
+  }
+  auto expect_group = [&] {
+    uint32_t count = 0;
+    for (auto &&[position, acc] : world.fuzzy_view<Position, Acc>()) {
+      ASSERT_EQ(position.x, acc.x);
+      count++;
+    }
+    auto view = world.group_view<Position, const Acc>();
+    static_assert(std::is_same_v<decltype(*view.begin()), std::tuple<Position &, const Acc &>>);
+    ASSERT_EQ(view.size(), count);
+    for (auto it = view.begin(); it != view.end(); ++it) {
+      auto &&[position, acc] = *it;
+      ASSERT_EQ(position.x, acc.x);
+      ASSERT_EQ(world.get_ptr<Position>(it.id()), &position);
+      count--;
+    }
+    ASSERT_EQ(count, 0);
+  };
+  expect_group();
+
+  world.sort<Acc>([](const Acc &lhs, const Acc &rhs) { return lhs.x > rhs.x; });
+  expect_group();
+  std::optional<int> last;
+  for (auto &&[position, acc] : world.group_view<Position, Acc>()) {
+    ASSERT_TRUE(!last || *last >= position.x);
+    last = position.x;
+  }
+}
+
+TEST(ECS_TEST, TAG_COMPONENT) {
+  struct Dead {};
+  struct Visible {};
+  using CurSettings = ecs::Settings<mpl::type_list<Position, Dead, Visible>>;
+  using EntityId = ecs::Entity<CurSettings>::Id;
+  ecs::World<CurSettings> world;
+
+  std::vector<EntityId> entities;
+  for (int i = 0; i < 100; i++) {
+    auto e = world.create();
+    auto _ = world.assign<Position>(e, i, 0, 0);
+    if (i % 2 == 0) {
+      auto __ = world.assign<Visible>(e);
+    }
+    entities.push_back(e);
+  }
+  ASSERT_TRUE(world.has<Visible>(entities[0]));
+  ASSERT_NE(world.get_ptr<Visible>(entities[0]), nullptr);
+  ASSERT_EQ(world.get_ptr<Visible>(entities[1]), nullptr);
+  {
+    // tags select entities but are not yielded
+    auto view = world.fuzzy_view<Visible, Position>();
+    static_assert(std::is_same_v<decltype(*view.begin()), std::tuple<Position &>>);
+    uint32_t count = 0;
+    for (auto &&[position] : view) {
+      ASSERT_EQ(position.x % 2, 0);
+      count++;
+    }
+    ASSERT_EQ(count, 50);
+    static_assert(std::is_same_v<decltype(*world.fuzzy_view<Dead>().begin()), std::tuple<>>);
+  }
+  {
+    // no column is allocated
+    auto stats = world.memory_stats();
+    ASSERT_EQ(stats.components[2].size, 50);
+    ASSERT_EQ(stats.components[2].capacity, 0);
+    ASSERT_EQ(stats.components[2].bytes_reserved, 0);
+  }
+
+  world.set_tag<Dead>(world.fuzzy_view<Visible>());
+  world.set_tag<Dead>(world.fuzzy_view<Position>());
+  ASSERT_EQ(world.memory_stats().components[1].size, 100);
+  world.clear_tag<Visible>(world.fuzzy_view<Dead>());
+  world.clear_tag<Dead>(world.exact_view<Position, Dead>());
+  for (auto &&e : entities) {
+    ASSERT_FALSE(world.has<Visible>(e));
+    ASSERT_FALSE(world.has<Dead>(e));
+  }
+  ASSERT_EQ(world.memory_stats().components[1].size, 0);
+  ASSERT_EQ(world.memory_stats().components[2].size, 0);
+}
+
+struct Buffer {
+  std::unique_ptr<int[]> data;
+  uint64_t size;
+  inline static int64_t alive = 0;
+
+  Buffer(uint64_t size) : data(std::make_unique<int[]>(size)), size(size) {
+    alive++;
+  }
+  Buffer(Buffer &&other) noexcept : data(std::move(other.data)), size(other.size) {
+    alive++;
+  }
+  auto operator=(Buffer &&other) noexcept -> Buffer & = default;
+  ~Buffer() {
+    alive--;
+  }
+};
+
+TEST(ECS_TEST, COMPONENT_EMPLACE) {
+  struct CurSettings : ecs::Settings<mpl::type_list<Position, Buffer>> {
+    using ObserverList = mpl::type_list<ecs::on_add<Position>, ecs::on_update<Position>, ecs::on_update<Buffer>>;
+  };
+  using EntityId = ecs::Entity<CurSettings>::Id;
+  static_assert(!std::is_default_constructible_v<Buffer> && !std::is_copy_constructible_v<Buffer>);
+  {
+    ecs::World<CurSettings> world;
+    uint32_t added = 0, updated = 0;
+    world.observe<ecs::on_add<Position>>([&](auto &&, auto ids) { added += ids.size(); });
+    world.observe<ecs::on_update<Position>>([&](auto &&, auto ids) { updated += ids.size(); });
+    world.observe<ecs::on_update<Buffer>>([&](auto &&, auto ids) { updated += ids.size(); });
+
+    std::vector<EntityId> entities;
+    Buffer *first = nullptr;
+    for (uint32_t i = 0; i < 5000; i++) {
+      auto e = world.create();
+      auto buffer = world.assign<Buffer>(e, i + 1);
+      ASSERT_EQ(buffer->size, i + 1);
+      auto _ = world.assign<Position>(e, 1, 2, 3);
+      entities.push_back(e);
+      first = first == nullptr ? buffer.get() : first;
+    }
+    ASSERT_EQ(Buffer::alive, 5000);
+    // storage is paged, growing never moves the values, unlike forking, see WORLD_FORK
+    ASSERT_EQ(world.get_ptr<Buffer>(entities[0]), first);
+    for (uint32_t i = 0; i < 5000; i += 2) {
+      world.remove<Buffer>(entities[i]);
+    }
+    for (uint32_t i = 1; i < 5000; i += 4) {
+      world.destroy(entities[i]);
+    }
+    ASSERT_EQ(Buffer::alive, 1250);
+    for (auto &&[buffer] : world.fuzzy_view<Buffer>()) {
+      ASSERT_EQ(buffer.size % 4, 0);
+      buffer.data[buffer.size - 1] = 1;
+    }
+
+    auto e = entities[3];
+    auto buffer = world.emplace_or_replace<Buffer>(e, 10);
+    ASSERT_EQ(buffer->size, 10);
+    ASSERT_EQ(Buffer::alive, 1250);
+    auto position = world.emplace_or_replace<Position>(entities[0], 4, 5, 6);
+    ASSERT_EQ(*position, (Position{4, 5, 6}));
+    world.emplace_or_replace<Position>(entities[0], Position{7, 8, 9});
+    ASSERT_EQ(*position, (Position{7, 8, 9}));
+    auto &&p = world.patch<Position>(entities[0], [](auto &&p) { p.x = 0; });
+    ASSERT_EQ(p, (Position{0, 8, 9}));
+    world.flush();
+    ASSERT_EQ(added, 5000);
+    ASSERT_EQ(updated, 4);
+  }
+  ASSERT_EQ(Buffer::alive, 0);
+}
+
+TEST(ECS_TEST, COMPONENT_EMPLACE_THROW) {
+  struct Boom {
+    int value;
+    Boom(int value) : value(value) {
+      if (value < 0) {
+        throw std::runtime_error("boom");
+      }
+    }
+  };
+  struct CurSettings : ecs::Settings<mpl::type_list<Position, Boom, std::vector<int>>> {
+    using ObserverList = mpl::type_list<ecs::on_add<Boom>>;
+  };
+  ecs::World<CurSettings> world;
+  uint32_t added = 0;
+  world.observe<ecs::on_add<Boom>>([&](auto &&, auto ids) { added += ids.size(); });
+  auto e = world.create();
+  auto _ = world.assign<Position>(e, 1, 2, 3);
+  ASSERT_THROW(auto __ = world.assign<Boom>(e, -1), std::runtime_error);
+  // the entity is left without the component
+  ASSERT_FALSE(world.has<Boom>(e));
+  ASSERT_EQ(world.get_ptr<Boom>(e), nullptr);
+  ASSERT_EQ(std::ranges::distance(world.fuzzy_view<Boom>()), 0);
+  ASSERT_EQ(world.memory_stats().components[1].size, 0);
+  auto boom = world.assign<Boom>(e, 1);
+  ASSERT_EQ(boom->value, 1);
+  ASSERT_EQ(std::ranges::distance(world.fuzzy_view<Boom>()), 1);
+  world.destroy(e);
+  world.flush();
+  ASSERT_EQ(added, 1);
+
+  // braces first, as components were always built
+  auto f = world.create();
+  auto values = world.assign<std::vector<int>>(f, 3, 5);
+  ASSERT_EQ(*values, (std::vector<int>{3, 5}));
+  world.emplace_or_replace<std::vector<int>>(f, 1, 2, 3);
+  ASSERT_EQ(*values, (std::vector<int>{1, 2, 3}));
+}
+
+TEST(ECS_TEST, WORLD_FORK) {
+  struct CurSettings : ecs::Settings<mpl::type_list<Position, Acc>> {
+    using GroupList = mpl::type_list<ecs::group<Position, Acc>>;
+  };
+  using EntityId = ecs::Entity<CurSettings>::Id;
+  ecs::World<CurSettings> world;
+  std::vector<EntityId> entities;
+  for (int i = 0; i < 10000; i++) {
+    auto e = world.create();
+    auto _ = world.assign<Position>(e, i, 0, 0);
+    if (i % 2 == 0) {
+      auto __ = world.assign<Acc>(e, i, 0, 0);
+    }
+    entities.push_back(e);
+  }
+  auto expect_origin = [&](const ecs::World<CurSettings> &w) {
+    for (int i = 0; i < 10000; i++) {
+      ASSERT_TRUE(w.valid(entities[i]));
+      ASSERT_EQ(*w.get_ptr<Position>(entities[i]), (Position{i, 0, 0}));
+      ASSERT_EQ(w.has<Acc>(entities[i]), i % 2 == 0);
+    }
+  };
+
+  auto fork = world.fork();
+  // pages are shared until written
+  ASSERT_EQ(std::as_const(fork).get_ptr<Position>(entities[1]), std::as_const(world).get_ptr<Position>(entities[1]));
+  for (auto &&[p] : fork.fuzzy_view<const Position>()) {
+    ASSERT_EQ(p.y, 0);
+  }
+  ASSERT_EQ(std::as_const(fork).get_ptr<Position>(entities[1]), std::as_const(world).get_ptr<Position>(entities[1]));
+
+  fork.get_ptr<Position>(entities[1])->y = 1;
+  for (auto &&[p, a] : fork.group_view<Position, Acc>()) {
+    p.z = a.x;
+  }
+  fork.destroy(entities[2]);
+  fork.remove<Acc>(entities[4]);
+  auto e = fork.create();
+  ASSERT_EQ(e.index, entities[2].index);
+  auto _ = fork.assign<Position>(e, -1, -1, -1);
+  ASSERT_NE(std::as_const(fork).get_ptr<Position>(entities[1]), std::as_const(world).get_ptr<Position>(entities[1]));
+  ASSERT_EQ(fork.get_ptr<Position>(entities[1])->y, 1);
+  ASSERT_EQ(fork.get_ptr<Position>(entities[6])->z, 6);
+  ASSERT_FALSE(fork.valid(entities[2]));
+  ASSERT_EQ((fork.group_view<Position, Acc>().size()), 4998);
+  expect_origin(world);
+  ASSERT_EQ((world.group_view<Position, Acc>().size()), 5000);
+
+  // pointers taken before a fork are not stable, the first write to their page copies it
+  {
+    auto *before = world.get_ptr<Position>(entities[1]);
+    auto *before_const = std::as_const(world).get_ptr<Position>(entities[1]);
+    auto snapshot = world.fork();
+    world.get_ptr<Position>(entities[3])->y = 1;  // same page
+    ASSERT_NE(world.get_ptr<Position>(entities[1]), before);
+    ASSERT_EQ(std::as_const(snapshot).get_ptr<Position>(entities[1]), before);
+    ASSERT_EQ(before_const, before);
+    world.get_ptr<Position>(entities[3])->y = 0;
+  }
+
+  // roll back
+  auto snapshot = world.fork();
+  for (auto &&[p] : world.fuzzy_view<Position>()) {
+    p.x = -p.x;
+  }
+  world.destroy(entities[0]);
+  world.restore(snapshot);
+  expect_origin(world);
+  ASSERT_EQ(world.create().index, 10000);
+}
+
+TEST(ECS_TEST, PREFAB) {
+  struct Mesh {
+    std::vector<int> vertices;
+  };
+  struct CurSettings : ecs::Settings<mpl::type_list<Position, Acc, Mesh>> {
+    using SharedList = mpl::type_list<Mesh>;
+    using GroupList = mpl::type_list<ecs::group<Position, Acc>>;
+  };
+  ecs::World<CurSettings> world;
+  auto prefab = world.create_prefab();
+  auto _ = world.assign<Position>(prefab, 1, 2, 3);
+  auto __ = world.assign<Acc>(prefab, 4, 5, 6);
+  auto mesh = world.assign<Mesh>(prefab, std::vector<int>(1000, 7));
+  static_assert(std::is_same_v<decltype(*mesh), const Mesh &>);
+  ASSERT_TRUE(world.valid(prefab));
+  ASSERT_EQ(world.fuzzy_view<Position>().begin(), world.fuzzy_view<Position>().end());
+  ASSERT_EQ((world.group_view<Position, Acc>().size()), 0);
+
+  auto entities = world.instantiate(prefab, 1000);
+  ASSERT_EQ(entities.size(), 1000);
+  ASSERT_EQ((world.group_view<Position, Acc>().size()), 1000);
+  for (auto &&e : entities) {
+    ASSERT_EQ(*world.get_ptr<Position>(e), (Position{1, 2, 3}));
+    ASSERT_EQ(*world.get_ptr<Acc>(e), (Acc{4, 5, 6}));
+    // one value referenced by every instance
+    ASSERT_EQ(world.get_ptr<Mesh>(e), world.get_ptr<Mesh>(prefab));
+  }
+  ASSERT_EQ(world.get_shared<Mesh>(prefab).use_count(), 1002);  // including the returned one
+  int count = 0;
+  for (auto &&[p, m] : world.fuzzy_view<Position, Mesh>()) {
+    static_assert(std::is_same_v<decltype(m), const Mesh &>);
+    p.x = m.vertices.size();
+    count++;
+  }
+  ASSERT_EQ(count, 1000);
+  ASSERT_EQ(world.get_ptr<Position>(prefab)->x, 1);
+
+  // instances are independent, replacing a shared value only affects that entity
+  world.emplace_or_replace<Mesh>(entities[0], std::vector<int>{1});
+  ASSERT_EQ(world.get_ptr<Mesh>(entities[0])->vertices.size(), 1);
+  ASSERT_EQ(world.get_ptr<Mesh>(entities[1])->vertices.size(), 1000);
+  auto handle = world.get_shared<Mesh>(entities[0]);
+  auto other = world.create();
+  auto ___ = world.assign<Mesh>(other, handle);
+  ASSERT_EQ(handle.use_count(), 3);
+
+  auto stats = world.memory_stats();
+  auto &&meshes = stats.components[mpl::index_of_v<Mesh, CurSettings::ComponentList>];
+  ASSERT_EQ(meshes.size, 1002);
+  // two distinct values, the one of the prefab and the one replaced
+  ASSERT_EQ(meshes.bytes_used, 1002 * (sizeof(std::shared_ptr<const Mesh>) + 2 * sizeof(uint64_t)) + 2 * sizeof(Mesh));
+
+  world.destroy(prefab);
+  ASSERT_EQ(world.get_ptr<Mesh>(entities[1])->vertices.size(), 1000);
+  ASSERT_EQ((world.group_view<Position, Acc>().size()), 1000);
+  // a value is no longer counted once no entity holds it
+  world.remove<Mesh>(other);
+  world.emplace_or_replace<Mesh>(entities[0], world.get_shared<Mesh>(entities[1]));
+  stats = world.memory_stats();
+  ASSERT_EQ(meshes.bytes_used, 1000 * (sizeof(std::shared_ptr<const Mesh>) + 2 * sizeof(uint64_t)) + sizeof(Mesh));
+
+  // move only components can not be copied into instances
+  ecs::World<ecs::Settings<mpl::type_list<Position, Buffer>>> buffers;
+  auto buffer_prefab = buffers.create_prefab();
+  auto ____ = buffers.assign<Position>(buffer_prefab, 1, 2, 3);
+  ASSERT_EQ(buffers.instantiate(buffer_prefab, 2).size(), 2);
+  auto _____ = buffers.assign<Buffer>(buffer_prefab, 4);
+  ASSERT_THROW(buffers.instantiate(buffer_prefab, 2), std::invalid_argument);
+  ASSERT_EQ(buffers.memory_stats().entities.size, 3);
+  // unless shared, instances then copy the reference
+  struct Material {
+    std::unique_ptr<int> texture;
+  };
+  struct MaterialSettings : ecs::Settings<mpl::type_list<Position, Material>> {
+    using SharedList = mpl::type_list<Material>;
+  };
+  ecs::World<MaterialSettings> materials;
+  auto material_prefab = materials.create_prefab();
+  auto ______ = materials.assign<Material>(material_prefab, std::make_unique<int>(8));
+  auto instances = materials.instantiate(material_prefab, 2);
+  ASSERT_EQ(materials.get_ptr<Material>(instances[1]), materials.get_ptr<Material>(material_prefab));
+  ASSERT_EQ(*materials.get_ptr<Material>(instances[0])->texture, 8);
+}
+
+TEST(ECS_TEST, DOUBLE_BUFFER) {
+  struct CurSettings : ecs::Settings<mpl::type_list<Position, Acc>> {
+    using BufferedList = mpl::type_list<Position>;
+  };
+  using EntityId = ecs::Entity<CurSettings>::Id;
+  ecs::World<CurSettings> world;
+  std::vector<EntityId> entities;
+  int64_t expect_sum = 0;
+  for (int i = 0; i < 1000; i++) {
+    auto e = world.create();
+    auto _ = world.assign<Position>(e, i, 0, 0);
+    auto __ = world.assign<Acc>(e, 1, 0, 0);
+    entities.push_back(e);
+    expect_sum += i;
+  }
+  // both buffers start with the assigned value
+  ASSERT_EQ(*std::as_const(world).get_ptr<Position>(entities[1]), (Position{1, 0, 0}));
+  ASSERT_EQ(*world.get_ptr<Position>(entities[1]), (Position{1, 0, 0}));
+
+  for (int tick = 0; tick < 3; tick++) {
+    // a rollback snapshot shares all pages, the buffers are still written and read by separate threads
+    auto snapshot = world.fork();
+    // physics writes the current buffer from the previous one while ai reads the previous one
+    std::thread physics([&] {
+      for (auto &&[cur, prev, a] : world.fuzzy_view<Position, const Position, const Acc>()) {
+        cur.x = prev.x + a.x;
+      }
+    });
+    int64_t sum = 0;
+    std::thread ai([&] {
+      for (auto &&[p] : world.fuzzy_view<const Position>()) {
+        sum += p.x;
+      }
+    });
+    physics.join();
+    ai.join();
+    ASSERT_EQ(sum, expect_sum);
+    world.swap_buffers();
+    expect_sum += 1000;
+    ASSERT_EQ(std::as_const(snapshot).get_ptr<Position>(entities[1])->x, 1 + tick);
+  }
+  ASSERT_EQ(std::as_const(world).get_ptr<Position>(entities[1])->x, 4);
+
+  // writes through the world are seen by readers after the swap
+  world.emplace_or_replace<Position>(entities[1], -1, 0, 0);
+  ASSERT_EQ(std::as_const(world).get_ptr<Position>(entities[1])->x, 4);
+  auto fork = world.fork();
+  world.swap_buffers();
+  ASSERT_EQ(std::as_const(world).get_ptr<Position>(entities[1])->x, -1);
+  ASSERT_EQ(std::as_const(fork).get_ptr<Position>(entities[1])->x, 4);
+  world.destroy(entities[0]);
+  ASSERT_EQ(std::as_const(world).get_ptr<Position>(entities[1])->x, -1);
+
+  // single entity writes start from the value read, and values not written survive idle ticks
+  for (int tick = 0; tick < 4; tick++) {
+    world.patch<Position>(entities[2], [](Position &p) { p.x += 1; });
+    world.swap_buffers();
+    ASSERT_EQ(std::as_const(world).get_ptr<Position>(entities[2])->x, 6 + tick);
+  }
+  world.emplace_or_replace<Position>(entities[2], 100, 0, 0);
+  for (int tick = 0; tick < 3; tick++) {
+    world.swap_buffers();
+    ASSERT_EQ(std::as_const(world).get_ptr<Position>(entities[2])->x, 100);
+    ASSERT_EQ(std::as_const(world).get_ptr<Position>(entities[1])->x, -1);
+  }
+  // values moved to another page keep both buffers, whichever ticks the two pages were last written in
+  std::vector<EntityId> more;
+  for (int i = 0; i < 1100; i++) {
+    auto e = world.create();
+    auto _ = world.assign<Position>(e, 7, 0, 0);
+    more.push_back(e);
+  }
+  for (int round = 0; round < 2; round++) {
+    world.swap_buffers();
+    auto moved = more[more.size() - 1 - round];
+    world.patch<Position>(moved, [](Position &p) { p.x++; });
+    world.destroy(entities[1 + 2 * round]);  // the last value moves into its hole
+    ASSERT_EQ(std::as_const(world).get_ptr<Position>(moved)->x, 7);
+    ASSERT_EQ(world.get_ptr<Position>(moved)->x, 8);
+    world.swap_buffers();
+    ASSERT_EQ(std::as_const(world).get_ptr<Position>(moved)->x, 8);
+    world.patch<Position>(more[1050], [](Position &p) { p.x++; });  // only the last page is written
+  }
+  ASSERT_EQ(std::as_const(world).get_ptr<Position>(entities[2])->x, 100);
+  for (uint64_t i = 4; i < entities.size(); i++) {
+    ASSERT_EQ(std::as_const(world).get_ptr<Position>(entities[i])->x, static_cast<int>(i) + 3);
+  }
+}
+
+TEST(ECS_TEST, RANGES) {
+  struct CurSettings : ecs::Settings<mpl::type_list<Position, Acc>> {
+    using GroupList = mpl::type_list<ecs::group<Position, Acc>>;
+  };
+  ecs::World<CurSettings> world;
+  using View = decltype(world.fuzzy_view<Position, const Acc>());
+  static_assert(std::ranges::view<View>);
+  static_assert(std::ranges::forward_range<View>);
+  static_assert(std::forward_iterator<std::ranges::iterator_t<View>>);
+  using GroupView = decltype(world.group_view<Position, const Acc>());
+  static_assert(std::ranges::view<GroupView>);
+  static_assert(std::ranges::random_access_range<GroupView>);
+  static_assert(std::ranges::sized_range<GroupView>);
+  static_assert(std::ranges::common_range<GroupView>);
+  using GroupIterator = std::ranges::iterator_t<GroupView>;
+  static_assert(std::random_access_iterator<GroupIterator>);
+  static_assert(
+      std::is_same_v<std::iterator_traits<GroupIterator>::iterator_category, std::random_access_iterator_tag>
+  );
+  // profiling does not change which range code compiles
+  using ProfiledView = decltype(std::declval<ecs::World<ProfilerSettings> &>().fuzzy_view<Position>());
+  static_assert(std::copyable<View> && std::copyable<ProfiledView>);
+  static_assert(std::ranges::viewable_range<ProfiledView &>);
+  for (int i = 0; i < 1000; i++) {
+    auto e = world.create();
+    auto _ = world.assign<Position>(e, i, 0, 0);
+    if (i % 2 == 0) {
+      auto __ = world.assign<Acc>(e, i, 0, 0);
+    }
+  }
+  {
+    auto view = world.fuzzy_view<Position>();
+    auto it = view.begin();
+    auto old = it++;
+    ASSERT_EQ(std::get<0>(*old).x, 0);
+    ASSERT_EQ(std::get<0>(*it).x, 1);
+    ASSERT_NE(old, it);
+    ASSERT_EQ(std::ranges::distance(view), 1000);
+    ASSERT_FALSE(view.empty());
+  }
+  {
+    auto odd = world.fuzzy_view<const Position>() |
+               std::views::filter([](auto &&t) { return std::get<0>(t).x % 2 == 1; }) | std::views::take(10);
+    int count = 0;
+    for (auto &&[p] : odd) {
+      ASSERT_EQ(p.x, count * 2 + 1);
+      count++;
+    }
+    ASSERT_EQ(count, 10);
+  }
+  {
+    auto view = world.group_view<Position, const Acc>();
+    ASSERT_EQ(view.size(), 500);
+    ASSERT_EQ(view.end() - view.begin(), 500);
+    ASSERT_EQ(std::get<1>(view[10]).x, std::get<0>(view[10]).x);
+    auto it = view.end();
+    --it;
+    ASSERT_EQ(std::get<0>(*it).x, std::get<0>(view.back()).x);
+    ASSERT_LT(view.begin(), it);
+    // split into chunks by iterator arithmetic, as a parallel algorithm would
+    std::vector<std::thread> workers;
+    constexpr int64_t kChunk = 128;
+    for (auto first = view.begin(); first < view.end(); first += kChunk) {
+      auto last = std::min(first + kChunk, view.end());
+      workers.emplace_back([first, last] {
+        std::for_each(first, last, [](auto &&t) {
+          auto &&[p, a] = t;
+          p.y = a.x + 1;
+        });
+      });
+    }
+    for (auto &&worker : workers) {
+      worker.join();
+    }
+    ASSERT_EQ(std::ranges::count_if(view, [](auto &&t) { return std::get<0>(t).y == std::get<1>(t).x + 1; }), 500);
+    ASSERT_EQ(std::ranges::distance(view | std::views::drop(100) | std::views::reverse), 400);
+  }
+  {
+    // the same on a world sharing its pages with a snapshot
+    auto snapshot = world.fork();
+    auto view = world.group_view<Position, const Acc>();
+    // a view copies nothing, the written pages are copied once before the threads start
+    auto id = view.begin().id();
+    ASSERT_EQ(std::as_const(world).get_ptr<Position>(id), std::as_const(snapshot).get_ptr<Position>(id));
+    world.detach<Position>();
+    ASSERT_NE(std::as_const(world).get_ptr<Position>(id), std::as_const(snapshot).get_ptr<Position>(id));
+    std::vector<std::thread> workers;
+    constexpr int64_t kChunk = 64;
+    for (auto first = view.begin(); first < view.end(); first += kChunk) {
+      auto last = std::min(first + kChunk, view.end());
+      workers.emplace_back([first, last] {
+        std::for_each(first, last, [](auto &&t) { std::get<0>(t).z = 1; });
+      });
+    }
+    for (auto &&worker : workers) {
+      worker.join();
+    }
+    ASSERT_EQ(std::ranges::count_if(view, [](auto &&t) { return std::get<0>(t).z == 1; }), 500);
+    auto snapshot_view = snapshot.group_view<const Position, const Acc>();
+    ASSERT_EQ(std::ranges::count_if(snapshot_view, [](auto &&t) { return std::get<0>(t).z == 1; }), 0);
+  }
+  {
+    ecs::World<ProfilerSettings> profiled;
+    for (int i = 0; i < 100; i++) {
+      auto e = profiled.create();
+      auto _ = profiled.assign<Position>(e, i, 0, 0);
+    }
+    {
+      auto view = profiled.fuzzy_view<Position>();
+      auto odd = view | std::views::filter([](auto &&t) { return std::get<0>(t).x % 2 == 1; });
+      ASSERT_EQ(std::ranges::distance(odd), 50);
+    }
+    // copies of the view share one scope
+    std::stringstream trace;
+    profiled.profiler().write_chrome_trace(trace);
+    auto events = trace.str();
+    auto first = events.find("\"cat\":\"view\"");
+    ASSERT_NE(first, std::string::npos);
+    ASSERT_EQ(events.find("\"cat\":\"view\"", first + 1), std::string::npos);
+  }
+}
+
+TEST(ECS_TEST, SPATIAL_GRID) {
+  struct CurSettings : ecs::Settings<mpl::type_list<Position, Acc>> {
+    using ObserverList =
+        mpl::type_list<ecs::on_add<Position>, ecs::on_update<Position>, ecs::on_remove<Position>, ecs::on_destroy>;
+  };
+  using EntityId = ecs::Entity<CurSettings>::Id;
+  using Grid = ecs::SpatialGrid<CurSettings, Position>;
+  ecs::World<CurSettings> world;
+  Grid grid(10);
+  grid.connect(world);
+  std::uniform_int_distribution<int> rand_coord(-100, 100);
+  std::vector<EntityId> entities;
+  for (int i = 0; i < 2000; i++) {
+    auto e = world.create();
+    auto _ = world.assign<Position>(e, rand_coord(seed), rand_coord(seed), rand_coord(seed));
+    entities.push_back(e);
+  }
+  std::vector<Grid::Sphere> spheres{{0, 0, 0, 30}, {-50, 20, 7.5, 12.5}, {100, 100, 100, 1}, {0, 0, 0, 1000}};
+  std::vector<Grid::Aabb> boxes{{-10, -10, -10, 10, 10, 10}, {-100, 0, 50, -20, 100, 55}};
+  auto expect_queries = [&] {
+    auto brute_force = [&](auto &&pred) {
+      std::vector<uint64_t> indices;
+      for (auto it = world.fuzzy_view<const Position>().begin(); it != std::default_sentinel; ++it) {
+        auto &&[p] = *it;
+        if (pred(p)) {
+          indices.push_back(it.id().index);
+        }
+      }
+      return indices;
+    };
+    // ids come in the order of the position pool
+    auto indices_of = [&](std::span<const EntityId> ids) {
+      std::vector<uint64_t> indices;
+      for (auto &&id : ids) {
+        indices.push_back(id.index);
+      }
+      EXPECT_TRUE(std::ranges::is_sorted(ids, {}, [&](const EntityId &id) { return world.position<Position>(id); }));
+      std::ranges::sort(indices);
+      return indices;
+    };
+    auto result = grid.radius(world, spheres);
+    ASSERT_EQ(result.size(), spheres.size());
+    for (uint64_t i = 0; i < spheres.size(); i++) {
+      auto &&q = spheres[i];
+      ASSERT_EQ(indices_of(result[i]), brute_force([&](const Position &p) {
+                  auto dx = p.x - q.x, dy = p.y - q.y, dz = p.z - q.z;
+                  return dx * dx + dy * dy + dz * dz <= q.radius * q.radius;
+                }));
+    }
+    ASSERT_EQ(result[3].size(), grid.size());
+    auto boxes_result = grid.aabb(world, boxes);
+    for (uint64_t i = 0; i < boxes.size(); i++) {
+      auto &&q = boxes[i];
+      ASSERT_EQ(indices_of(boxes_result[i]), brute_force([&](const Position &p) {
+                  return p.x >= q.min_x && p.x <= q.max_x && p.y >= q.min_y && p.y <= q.max_y && p.z >= q.min_z &&
+                         p.z <= q.max_z;
+                }));
+    }
+  };
+  // nothing is indexed until the events are flushed
+  ASSERT_EQ(grid.size(), 0);
+  world.flush();
+  ASSERT_EQ(grid.size(), 2000);
+  expect_queries();
+
+  for (int i = 0; i < 500; i++) {
+    world.patch<Position>(entities[i], [&](Position &p) { p.x = rand_coord(seed); });
+  }
+  for (int i = 500; i < 600; i++) {
+    world.remove<Position>(entities[i]);
+  }
+  for (int i = 600; i < 700; i++) {
+    world.destroy(entities[i]);
+    // reuse the index in the same batch
+    auto e = world.create();
+    auto _ = world.assign<Position>(e, rand_coord(seed), rand_coord(seed), rand_coord(seed));
+    entities.push_back(e);
+  }
+  // added and destroyed before the flush
+  auto e = world.create();
+  auto _ = world.assign<Position>(e, 0, 0, 0);
+  world.destroy(e);
+  world.flush();
+  ASSERT_EQ(grid.size(), 1900);
+  expect_queries();
+
+  // writes through views are reported by hand
+  for (auto &&[p] : world.fuzzy_view<Position>()) {
+    p.y = -p.y;
+  }
+  grid.update(world, entities);
+  expect_queries();
+  Grid rebuilt(25);
+  rebuilt.rebuild(world);
+  ASSERT_EQ(rebuilt.size(), 1900);
+  ASSERT_EQ(rebuilt.radius(world, spheres).ids().size(), grid.radius(world, spheres).ids().size());
+
+  // indexing only reads, pages shared with a snapshot stay shared
+  auto snapshot = world.fork();
+  rebuilt.rebuild(world);
+  grid.update(world, entities);
+  ASSERT_EQ(std::as_const(world).get_ptr<Position>(entities[1]), std::as_const(snapshot).get_ptr<Position>(entities[1]));
+
+  // restore raises no event, the grid is rebuilt after it
+  auto origin = world.create();
+  auto __ = world.assign<Position>(origin, 0, 0, 0);
+  world.flush();
+  auto before_move = world.fork();
+  world.patch<Position>(origin, [](Position &p) { p.x = 1000; });
+  world.flush();
+  std::vector<Grid::Sphere> at_origin{{0, 0, 0, 0.5}};
+  auto found = [&] {
+    auto result = grid.radius(world, at_origin);
+    return std::ranges::any_of(result.ids(), [&](const EntityId &id) { return id.index == origin.index; });
+  };
+  ASSERT_FALSE(found());
+  world.restore(before_move);
+  grid.rebuild(world);
+  ASSERT_TRUE(found());
+  expect_queries();
+
+  // prefabs are skipped like in views, their instances are indexed
+  auto prefab = world.create_prefab();
+  auto ___ = world.assign<Position>(prefab, 0, 0, 0);
+  world.flush();
+  ASSERT_FALSE(world.alive(prefab));
+  ASSERT_EQ(grid.size(), 1901);
+  auto instances = world.instantiate(prefab, 2);
+  world.flush();
+  ASSERT_EQ(grid.size(), 1903);
+  rebuilt.rebuild(world);
+  ASSERT_EQ(rebuilt.size(), grid.size());
+  expect_queries();
+
+  // huge and infinite queries find every entity, once
+  constexpr float kMax = std::numeric_limits<float>::max();
+  constexpr float kInf = std::numeric_limits<float>::infinity();
+  ecs::World<CurSettings> spread;
+  Grid sparse(1);
+  for (int i = 0; i < 100; i++) {
+    auto e = spread.create();
+    auto _ = spread.assign<Position>(e, i * 100000, -i, i % 10);
+  }
+  sparse.rebuild(spread);
+  std::vector<Grid::Aabb> huge_boxes{{-kMax, -kMax, -kMax, kMax, kMax, kMax}, {-kInf, -kInf, -kInf, kInf, kInf, kInf},
+                                     {-1, -100, 0, 1e7, 0, 9}};
+  auto huge_boxes_result = sparse.aabb(spread, huge_boxes);
+  for (uint64_t i = 0; i < huge_boxes.size(); i++) {
+    ASSERT_EQ(huge_boxes_result[i].size(), 100);
+    std::set<uint64_t> indices;
+    for (auto &&id : huge_boxes_result[i]) {
+      indices.insert(id.index);
+    }
+    ASSERT_EQ(indices.size(), 100);
+  }
+  std::vector<Grid::Sphere> huge_spheres{{0, 0, 0, 1e30}, {0, 0, 0, kInf}, {0, 0, 0, kMax}};
+  auto huge_spheres_result = sparse.radius(spread, huge_spheres);
+  for (uint64_t i = 0; i < huge_spheres.size(); i++) {
+    ASSERT_EQ(huge_spheres_result[i].size(), 100);
+  }
+}
+
 // TODO: test exact view
\ No newline at end of file
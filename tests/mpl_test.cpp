@@ -1,6 +1,7 @@
 #include <experimental/type_traits>
 #include <pico_libs/mpl/bitset.hpp>
 #include <pico_libs/mpl/type_list.hpp>
+#include <pico_libs/mpl/type_name.hpp>
 using namespace xac;
 
 #include "gtest/gtest.h"
@@ -40,6 +41,12 @@ TEST(MPL_TEST, TYPE_LIST) {
 
   static_assert(std::is_same_v<mpl::rename<std::tuple, TestTypeList>, TestTuple>);
   static_assert(std::is_same_v<mpl::rename<mpl::type_list, TestTuple>, TestTypeList>);
+
+  static_assert(std::is_same_v<mpl::concat_t<mpl::type_list<int>, mpl::type_list<>, mpl::type_list<bool, double>>, TestTypeList>);
+  static_assert(std::is_same_v<mpl::filter_t<std::is_integral, TestTypeList>, mpl::type_list<int, bool>>);
+  static_assert(std::is_same_v<mpl::filter_t<std::is_floating_point, TestTuple>, std::tuple<double>>);
+  static_assert(std::is_same_v<mpl::filter_t<std::is_void, TestTypeList>, mpl::type_list<>>);
+  static_assert(std::is_same_v<mpl::filter_t<std::is_reference, mpl::type_list<int &, int>>, mpl::type_list<int &>>);
 }
 
 TEST(MPL_TEST, BIT_LIST) {
@@ -59,3 +66,11 @@ TEST(MPL_TEST, BIT_LIST) {
                                                                                                       "00001110")
   );
 }
+
+TEST(MPL_TEST, TYPE_NAME) {
+  struct Foo {};
+  static_assert(mpl::type_name_v<int> == "int");
+  static_assert(mpl::type_name<double>() == "double");
+  ASSERT_NE(mpl::type_name_v<Foo>.find("Foo"), std::string_view::npos);
+  ASSERT_EQ(mpl::type_name_v<std::tuple<int>>, "std::tuple<int>");
+}
\ No newline at end of file